@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.hxx"
+#include "buffer_pool.hxx"
+#include "metrics.hxx"
 
 #include <array>
 #include <bit>
@@ -31,13 +33,27 @@ constexpr auto nbeswap(std::integral auto val) noexcept
 
 } // namespace util {}
 
-boost::asio::experimental::coro<std::string> reader(boost::asio::ip::tcp::socket& s)
+
+namespace stats
+{
+
+inline cxx_coro::metrics::Counter accepted{ "coro_echo.accepted" };
+inline cxx_coro::metrics::Gauge connections{ "coro_echo.connections" };
+inline cxx_coro::metrics::Counter messages{ "coro_echo.messages" };
+inline cxx_coro::metrics::Counter bytes_in{ "coro_echo.bytes_in" };
+inline cxx_coro::metrics::Counter bytes_out{ "coro_echo.bytes_out" };
+inline cxx_coro::metrics::Histogram handler_latency{ "coro_echo.handler_latency_ns" };
+
+} // namespace stats {}
+
+// Yields each message in a buffer leased from 'pool'; the consumer returns it by dropping the lease,
+// so in steady state the same buffer cycles between reader and writer without allocating or copying.
+boost::asio::experimental::coro<cxx_coro::buffer_lease> reader(boost::asio::ip::tcp::socket& s, cxx_coro::buffer_pool& pool)
 {
     VerboseBlock("reader()");
 
     try
     {
-        std::vector<char> data;
         for (;;)
         {
             Verbose("receiving...");
@@ -46,12 +62,15 @@ boost::asio::experimental::coro<std::string> reader(boost::asio::ip::tcp::socket
 
             size = util::nbeswap(size);
             Verbose("receiving {} bytes...", size);
-            data.resize(size);
-            co_await boost::asio::async_read(s, boost::asio::buffer(data), boost::asio::deferred);
+            auto data = pool.acquire(size);
+            co_await boost::asio::async_read(s, boost::asio::buffer(data.data(), data.size()), boost::asio::deferred);
+
+            stats::messages.add();
+            stats::bytes_in.add(sizeof(size) + data.size());
 
-            Info("received [{}]", cxx_coro::binaryToAscii({ data.data(), size }));
+            Info("received [{}]", cxx_coro::binaryToAscii(data.view()));
 
-            co_yield std::string{ data.data(), size };
+            co_yield std::move(data);
         }
     }
     catch (std::exception& e)
@@ -65,9 +84,12 @@ boost::asio::awaitable<void> client_handler(boost::asio::ip::tcp::socket s)
 {
     VerboseBlock("client_handler()");
 
+    cxx_coro::metrics::GaugeScope active{ stats::connections };
+
     try
     {
-        auto r = reader(s);
+        cxx_coro::buffer_pool pool{ 2 }; // one message in flight plus the one being read
+        auto r = reader(s, pool);
 
         for (;;)
         {
@@ -75,17 +97,21 @@ boost::asio::awaitable<void> client_handler(boost::asio::ip::tcp::socket s)
             if (msg.has_value())
             {
                 auto& v = *msg;
+                auto started = cxx_coro::metrics::now();
 
                 Verbose("sending...");
                 
-                auto size = util::nbeswap(static_cast<std::uint16_t>(v.length()));
+                auto size = util::nbeswap(static_cast<std::uint16_t>(v.size()));
                 std::array seq
                 { 
                     boost::asio::buffer(&size, sizeof(size)), 
-                    boost::asio::buffer(v) 
+                    boost::asio::buffer(v.data(), v.size()) 
                 };
 
-                co_await boost::asio::async_write(s, seq, boost::asio::deferred);
+                auto written = co_await boost::asio::async_write(s, seq, boost::asio::deferred);
+
+                stats::bytes_out.add(written);
+                stats::handler_latency.recordSince(started);
             }
         }
     }
@@ -108,6 +134,7 @@ boost::asio::awaitable<void> listener(boost::asio::ip::tcp::endpoint ep)
         Verbose("accepting...");
         boost::asio::ip::tcp::socket socket{ co_await acceptor.async_accept(boost::asio::deferred) };
 
+        stats::accepted.add();
         Info("new connection started");
         boost::asio::co_spawn(executor, client_handler(std::move(socket)), boost::asio::detached);
     }
@@ -1,4 +1,7 @@
 #include "echo_server.hxx"
+#include "metrics_admin.hxx"
+
+#include <optional>
 
 
 
@@ -14,6 +17,28 @@ std::pair<std::string_view, std::string_view> get_host_port(char* option)
     return { option, "" };
 }
 
+// matches '--name' and '--name=value'
+std::optional<std::string_view> get_option(char* option, std::string_view name)
+{
+    std::string_view o{ option };
+    if (!o.starts_with(name))
+        return std::nullopt;
+
+    o.remove_prefix(name.length());
+    if (o.empty())
+        return o;
+
+    if (o.front() != '=')
+        return std::nullopt;
+
+    return o.substr(1);
+}
+
+void usage(char* self)
+{
+    Info("Usage: {} [host[:port]] [--admin=port]", self);
+}
+
 
 } // namespace {}
 
@@ -23,16 +48,29 @@ int main(int argc, char** argv)
 {
     VerboseBlock("main()");
 
-    if (argc > 2)
-    {
-        Info("Usage: {} [host[:port]]", argv[0]);
-        std::exit(EXIT_FAILURE);
-    }
+    char* listen_on = nullptr;
+    std::string_view admin_port;
 
-    if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")))
+    for (int i = 1; i < argc; ++i)
     {
-        Info("Usage: {} [host[:port]]", argv[0]);
-        std::exit(EXIT_SUCCESS);
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+        {
+            usage(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        }
+        else if (auto v = get_option(argv[i], "--admin"); v && !v->empty())
+        {
+            admin_port = *v;
+        }
+        else if (argv[i][0] != '-' && !listen_on)
+        {
+            listen_on = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+            std::exit(EXIT_FAILURE);
+        }
     }
 
     boost::asio::io_context context;
@@ -46,9 +84,18 @@ int main(int argc, char** argv)
         context.stop();
     });
 
-    if (argc > 1) 
+#if CXX_CORO_LINUX
+    boost::asio::co_spawn(context, cxx_coro::metrics::dump_on_signal(), boost::asio::detached);
+#endif
+
+    if (!admin_port.empty())
     {
-        const auto [host, port] = get_host_port(argv[1]);
+        cxx_coro::metrics::serve_admin(context.get_executor(), admin_port);
+    }
+
+    if (listen_on) 
+    {
+        const auto [host, port] = get_host_port(listen_on);
 
         echo_server::accept(context.get_executor(), host, port);
     }
@@ -60,4 +107,4 @@ int main(int argc, char** argv)
     context.run();
      
     return 0;
-}
\ No newline at end of file
+}
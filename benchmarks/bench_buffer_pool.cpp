@@ -0,0 +1,79 @@
+#include "harness.hxx"
+#include "buffer_pool.hxx"
+
+#include <cstring>
+
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/coro.hpp>
+
+
+namespace
+{
+
+// the memcpy() stands in for the socket read in asio_coro's reader()
+
+boost::asio::experimental::coro<std::string> string_reader(boost::asio::io_context&, const std::string& wire)
+{
+    std::vector<char> data;
+    for (;;)
+    {
+        data.resize(wire.size());
+        std::memcpy(data.data(), wire.data(), wire.size());
+
+        co_yield std::string{ data.data(), data.size() };
+    }
+}
+
+boost::asio::experimental::coro<cxx_coro::buffer_lease> lease_reader(boost::asio::io_context&, const std::string& wire, cxx_coro::buffer_pool& pool)
+{
+    for (;;)
+    {
+        auto data = pool.acquire(wire.size());
+        std::memcpy(data.data(), wire.data(), wire.size());
+
+        co_yield std::move(data);
+    }
+}
+
+boost::asio::awaitable<void> consume(auto& reader, std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; ++i)
+    {
+        auto msg = co_await reader.async_resume(boost::asio::use_awaitable);
+        cxx_coro::bench::doNotOptimize(msg);
+    }
+}
+
+void yield_string(cxx_coro::bench::State& state)
+{
+    boost::asio::io_context io;
+    std::string wire(static_cast<std::size_t>(state.arg()), 'x');
+
+    auto r = string_reader(io, wire);
+    boost::asio::co_spawn(io, consume(r, state.iterations()), boost::asio::detached);
+
+    io.run();
+
+    state.setItemsProcessed(state.iterations());
+}
+
+void yield_lease(cxx_coro::bench::State& state)
+{
+    boost::asio::io_context io;
+    std::string wire(static_cast<std::size_t>(state.arg()), 'x');
+    cxx_coro::buffer_pool pool{ 2 };
+
+    auto r = lease_reader(io, wire, pool);
+    boost::asio::co_spawn(io, consume(r, state.iterations()), boost::asio::detached);
+
+    io.run();
+
+    state.setItemsProcessed(state.iterations());
+}
+
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(yield_string, { 16, 1024, 32768 });
+CXX_CORO_BENCHMARK(yield_lease, { 16, 1024, 32768 });
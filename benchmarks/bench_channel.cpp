@@ -0,0 +1,137 @@
+#include "harness.hxx"
+#include "channel.hxx"
+
+#include <thread>
+
+
+namespace
+{
+
+// Three stages, each on its own io_context and thread: produce -> double -> sum.
+// Receivers take whatever else is ready with drain() before suspending again, and senders
+// only fall back to the send() coroutine when try_send() finds the channel full.
+
+template <typename _Channel>
+boost::asio::awaitable<void> produce(_Channel& out, std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; ++i)
+    {
+        if (!out.try_send(i))
+            co_await out.send(std::move(i));
+    }
+
+    out.close();
+}
+
+template <typename _In, typename _Out>
+boost::asio::awaitable<void> transform(_In& in, _Out& out)
+{
+    while (auto v = co_await in.receive())
+    {
+        if (!out.try_send(*v * 2))
+            co_await out.send(*v * 2);
+
+        auto more = in.drain();
+        while (auto x = more.next())
+        {
+            if (!out.try_send(*x * 2))
+                co_await out.send(*x * 2);
+        }
+    }
+
+    out.close();
+}
+
+template <typename _Channel>
+boost::asio::awaitable<void> sum(_Channel& in, std::uint64_t& total)
+{
+    while (auto v = co_await in.receive())
+    {
+        total += *v;
+
+        auto more = in.drain();
+        while (auto x = more.next())
+        {
+            total += *x;
+        }
+    }
+}
+
+template <typename _Channel>
+void pipeline(cxx_coro::bench::State& state)
+{
+    auto capacity = static_cast<std::size_t>(state.arg());
+    _Channel first{ capacity };
+    _Channel second{ capacity };
+    std::uint64_t total = 0;
+
+    boost::asio::io_context a, b, c;
+    boost::asio::co_spawn(a, produce(first, state.iterations()), boost::asio::detached);
+    boost::asio::co_spawn(b, transform(first, second), boost::asio::detached);
+    boost::asio::co_spawn(c, sum(second, total), boost::asio::detached);
+
+    {
+        std::jthread ta{ [&a]() { a.run(); } };
+        std::jthread tb{ [&b]() { b.run(); } };
+        c.run();
+    }
+
+    cxx_coro::bench::doNotOptimize(total);
+    state.setItemsProcessed(state.iterations());
+}
+
+void pipeline_spsc(cxx_coro::bench::State& state)
+{
+    pipeline<channel::spsc_channel<std::uint64_t>>(state);
+}
+
+void pipeline_mpmc(cxx_coro::bench::State& state)
+{
+    pipeline<channel::async_channel<std::uint64_t>>(state);
+}
+
+// the same pipeline with one post() per item and stage
+void pipeline_post(cxx_coro::bench::State& state)
+{
+    std::uint64_t total = 0;
+
+    boost::asio::io_context a, b, c;
+
+    // b and c must not run out of work before the last item has passed through them
+    auto work_b = boost::asio::make_work_guard(b);
+    auto work_c = boost::asio::make_work_guard(c);
+
+    boost::asio::post(a, [&]()
+    {
+        for (std::uint64_t i = 0; i < state.iterations(); ++i)
+        {
+            boost::asio::post(b, [&c, &total, i]()
+            {
+                boost::asio::post(c, [&total, v = i * 2]() { total += v; });
+            });
+        }
+
+        // behind every item in b's queue, and then in c's
+        boost::asio::post(b, [&]()
+        {
+            boost::asio::post(c, [&work_c]() { work_c.reset(); });
+            work_b.reset();
+        });
+    });
+
+    {
+        std::jthread ta{ [&a]() { a.run(); } };
+        std::jthread tb{ [&b]() { b.run(); } };
+        c.run();
+    }
+
+    cxx_coro::bench::doNotOptimize(total);
+    state.setItemsProcessed(state.iterations());
+}
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(pipeline_spsc, { 64, 1024 });
+CXX_CORO_BENCHMARK(pipeline_mpmc, { 64, 1024 });
+CXX_CORO_BENCHMARK(pipeline_post);
@@ -0,0 +1,84 @@
+#include "harness.hxx"
+
+#include <iostream>
+#include <string>
+
+
+namespace
+{
+
+struct null_buffer
+    : public std::streambuf
+{
+    int overflow(int c) override
+    {
+        return c;
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize n) override
+    {
+        return n;
+    }
+};
+
+std::string make_payload(std::size_t size)
+{
+    std::string s(size, '\0');
+    for (std::size_t i = 0; i < size; ++i)
+        s[i] = static_cast<char>(i);
+
+    return s;
+}
+
+void binary_to_hex(cxx_coro::bench::State& state)
+{
+    auto payload = make_payload(static_cast<std::size_t>(state.arg()));
+
+    state.resetTimer();
+
+    for (std::uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        cxx_coro::bench::doNotOptimize(cxx_coro::binaryToHex(payload));
+    }
+
+    state.setBytesProcessed(state.iterations() * payload.size());
+}
+
+void binary_to_ascii(cxx_coro::bench::State& state)
+{
+    auto payload = make_payload(static_cast<std::size_t>(state.arg()));
+
+    state.resetTimer();
+
+    for (std::uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        cxx_coro::bench::doNotOptimize(cxx_coro::binaryToAscii(payload));
+    }
+
+    state.setBytesProcessed(state.iterations() * payload.size());
+}
+
+// the default tracer formats the line and writes it to std::cout under a lock;
+// the stream is redirected so only the tracer's own cost is measured
+void writeln_default_tracer(cxx_coro::bench::State& state)
+{
+    null_buffer null;
+    auto prev = std::cout.rdbuf(&null);
+
+    for (std::uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        cxx_coro::writeln(cxx_coro::Level::Info, "received [Mary had a little lamb]");
+    }
+
+    std::cout.rdbuf(prev);
+
+    state.setItemsProcessed(state.iterations());
+}
+
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(binary_to_hex, { 16, 1024 });
+CXX_CORO_BENCHMARK(binary_to_ascii, { 16, 1024 });
+CXX_CORO_BENCHMARK(writeln_default_tracer);
@@ -0,0 +1,35 @@
+#include "harness.hxx"
+
+#include <boost/asio.hpp>
+
+
+namespace
+{
+
+// the same hop as asio_dispatch's f(): io_context -> strand on a thread_pool -> back
+boost::asio::awaitable<void> hop(auto strand, std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; ++i)
+    {
+        co_await boost::asio::dispatch(boost::asio::bind_executor(strand, boost::asio::deferred));
+        co_await boost::asio::dispatch(boost::asio::deferred);
+    }
+}
+
+void strand_hop(cxx_coro::bench::State& state)
+{
+    boost::asio::io_context io;
+    boost::asio::thread_pool tp(1);
+
+    boost::asio::co_spawn(io, hop(boost::asio::make_strand(tp), state.iterations()), boost::asio::detached);
+
+    io.run();
+
+    state.setItemsProcessed(state.iterations());
+}
+
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(strand_hop);
@@ -0,0 +1,77 @@
+#include "harness.hxx"
+#include "event.hxx"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+// one awaiter suspends, then the same thread sets the event and resumes it
+void event_set_await(cxx_coro::bench::State& state)
+{
+    async_event event;
+
+    for (std::uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        event.reset();
+        example(event);
+        event.set();
+    }
+
+    state.setItemsProcessed(state.iterations());
+}
+
+// arg() threads keep awaiting the event while another thread keeps setting and resetting it
+void event_contended(cxx_coro::bench::State& state)
+{
+    async_event event;
+    std::atomic<bool> stop = false;
+    std::atomic<std::size_t> ready = 0;
+
+    auto waiters = static_cast<std::size_t>(state.arg());
+
+    std::thread setter([&]()
+    {
+        while (ready.load(std::memory_order_acquire) < waiters)
+            std::this_thread::yield();
+
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            event.set();
+            event.reset();
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < waiters; ++t)
+    {
+        threads.emplace_back([&]()
+        {
+            ready.fetch_add(1, std::memory_order_release);
+
+            for (std::uint64_t i = 0; i < state.iterations(); ++i)
+                example(event);
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    stop = true;
+    setter.join();
+
+    // release anybody still queued
+    event.set();
+
+    state.setItemsProcessed(state.iterations() * waiters);
+}
+
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(event_set_await);
+CXX_CORO_BENCHMARK(event_contended, { 1, 2, 4 });
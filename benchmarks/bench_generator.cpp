@@ -0,0 +1,55 @@
+#include "harness.hxx"
+#include "generator.hxx"
+
+#include <numeric>
+#include <vector>
+
+
+namespace
+{
+
+generator<std::uint64_t> counter()
+{
+    for (std::uint64_t i = 0;; ++i)
+    {
+        co_yield std::move(i);
+    }
+}
+
+void generator_next(cxx_coro::bench::State& state)
+{
+    auto g = counter();
+
+    for (std::uint64_t i = 0; i < state.iterations(); ++i)
+    {
+        cxx_coro::bench::doNotOptimize(g.next());
+    }
+
+    state.setItemsProcessed(state.iterations());
+}
+
+void generator_range(cxx_coro::bench::State& state)
+{
+    std::vector<std::uint64_t> v(state.iterations());
+    std::iota(v.begin(), v.end(), 0);
+
+    auto g = make_generator_from(std::move(v));
+
+    state.resetTimer();
+
+    std::uint64_t sum = 0;
+    for (auto& x : g)
+    {
+        sum += x;
+    }
+
+    cxx_coro::bench::doNotOptimize(sum);
+    state.setItemsProcessed(state.iterations());
+}
+
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(generator_next);
+CXX_CORO_BENCHMARK(generator_range);
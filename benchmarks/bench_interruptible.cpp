@@ -0,0 +1,84 @@
+#include "harness.hxx"
+#include "interruptible.hxx"
+
+
+namespace
+{
+
+struct plain_task
+{
+    struct promise_type
+    {
+        plain_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+};
+
+// always ready, so only the await machinery itself is measured
+struct ready_awaitable
+{
+    bool await_ready() const noexcept
+    {
+        return true;
+    }
+
+    void await_suspend(std::coroutine_handle<>) const noexcept
+    {
+    }
+
+    void on_terminate(boost::system::error_code) noexcept
+    {
+    }
+
+    int await_resume() const noexcept
+    {
+        return 1;
+    }
+};
+
+interruptible_task interruptible_loop(std::uint64_t n, std::uint64_t& sum)
+{
+    for (std::uint64_t i = 0; i < n; ++i)
+    {
+        sum += co_await ready_awaitable{};
+    }
+}
+
+plain_task plain_loop(std::uint64_t n, std::uint64_t& sum)
+{
+    for (std::uint64_t i = 0; i < n; ++i)
+    {
+        sum += co_await ready_awaitable{};
+    }
+}
+
+void interruptible_await_transform(cxx_coro::bench::State& state)
+{
+    std::uint64_t sum = 0;
+
+    interruptible_loop(state.iterations(), sum);
+
+    cxx_coro::bench::doNotOptimize(sum);
+    state.setItemsProcessed(state.iterations());
+}
+
+// baseline: the same loop in a coroutine without await_transform()
+void plain_await(cxx_coro::bench::State& state)
+{
+    std::uint64_t sum = 0;
+
+    plain_loop(state.iterations(), sum);
+
+    cxx_coro::bench::doNotOptimize(sum);
+    state.setItemsProcessed(state.iterations());
+}
+
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(interruptible_await_transform);
+CXX_CORO_BENCHMARK(plain_await);
@@ -0,0 +1,232 @@
+#include "harness.hxx"
+
+#if CXX_CORO_LINUX
+
+#include "shm_transport.hxx"
+
+#include <filesystem>
+#include <thread>
+
+
+namespace
+{
+
+// client_handler() on its own thread serves one connection over each transport; the client sends
+// state.iterations() frames of state.arg() bytes, keeping window of them in flight. With a window
+// of one the time per iteration is the round-trip latency, with more it is throughput.
+template <typename _Connect>
+void transport_round_trip(cxx_coro::bench::State& state, std::size_t window, _Connect connect)
+{
+    // client_handler() logs every message
+    auto tracer = cxx_coro::setTracer([](cxx_coro::Level, std::uint32_t, std::string_view) {});
+
+    boost::asio::io_context server;
+    auto work = boost::asio::make_work_guard(server);
+    std::thread t{ [&server]() { server.run(); } };
+
+    auto size = static_cast<std::size_t>(state.arg());
+    std::vector<char> message(2 + size, 'x');
+    message[0] = char(size >> 8);
+    message[1] = char(size & 0xff);
+
+    boost::asio::io_context client;
+    boost::asio::co_spawn(client, [&]() -> boost::asio::awaitable<void>
+    {
+        auto s = co_await connect(server);
+        std::vector<char> reply(message.size());
+
+        state.resetTimer();
+
+        for (std::uint64_t done = 0; done < state.iterations(); )
+        {
+            auto n = std::min<std::uint64_t>(window, state.iterations() - done);
+
+            for (std::uint64_t i = 0; i < n; ++i)
+                co_await boost::asio::async_write(s, boost::asio::buffer(message), boost::asio::deferred);
+
+            for (std::uint64_t i = 0; i < n; ++i)
+                co_await boost::asio::async_read(s, boost::asio::buffer(reply), boost::asio::deferred);
+
+            done += n;
+        }
+    }, boost::asio::detached);
+
+    client.run();
+
+    work.reset();
+    server.stop();
+    t.join();
+
+    cxx_coro::setTracer(std::move(tracer));
+
+    state.setItemsProcessed(state.iterations());
+    state.setBytesProcessed(state.iterations() * message.size() * 2);
+}
+
+auto tcp_loopback(boost::asio::io_context& server) -> boost::asio::awaitable<boost::asio::ip::tcp::socket>
+{
+    boost::asio::ip::tcp::acceptor acceptor{ server, boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), 0 } };
+
+    boost::asio::ip::tcp::socket s{ co_await boost::asio::this_coro::executor };
+    co_await s.async_connect(acceptor.local_endpoint(), boost::asio::deferred);
+    s.set_option(boost::asio::ip::tcp::no_delay(true));
+
+    auto accepted = acceptor.accept();
+    accepted.set_option(boost::asio::ip::tcp::no_delay(true));
+    boost::asio::co_spawn(server, echo_server::client_handler(std::move(accepted)), boost::asio::detached);
+
+    co_return s;
+}
+
+std::string socket_path(std::string_view name)
+{
+    return (std::filesystem::temp_directory_path() / std::format("cxx_coro_bench_{}.{}", name, ::getpid())).string();
+}
+
+auto unix_socket(boost::asio::io_context& server) -> boost::asio::awaitable<boost::asio::local::stream_protocol::socket>
+{
+    auto path = socket_path("unix");
+    boost::asio::local::stream_protocol::acceptor acceptor{ server, boost::asio::local::stream_protocol::endpoint{ path } };
+
+    boost::asio::local::stream_protocol::socket s{ co_await boost::asio::this_coro::executor };
+    co_await s.async_connect(acceptor.local_endpoint(), boost::asio::deferred);
+
+    boost::asio::co_spawn(server, echo_server::client_handler(acceptor.accept()), boost::asio::detached);
+    std::filesystem::remove(path);
+
+    co_return s;
+}
+
+auto shared_memory(boost::asio::io_context& server) -> boost::asio::awaitable<echo_server::shm::stream>
+{
+    auto path = socket_path("shm");
+    echo_server::shm::accept(server.get_executor(), path);
+
+    // the listener is spawned on the server thread; wait for its socket to appear
+    while (!std::filesystem::exists(path))
+        std::this_thread::yield();
+
+    auto s = co_await echo_server::shm::connect(path);
+    std::filesystem::remove(path);
+
+    co_return s;
+}
+
+
+// mux::client_handler() over a unix socket with a handler that holds every request starting with
+// 's' for a millisecond. Each iteration sends one such slow request followed by state.arg() fast
+// ones; fast_before_slow counts the fast replies that overtook it, state.arg() when none waited.
+void mux_slow_request(cxx_coro::bench::State& state)
+{
+    auto tracer = cxx_coro::setTracer([](cxx_coro::Level, std::uint32_t, std::string_view) {});
+
+    boost::asio::io_context server;
+    auto work = boost::asio::make_work_guard(server);
+    std::thread t{ [&server]() { server.run(); } };
+
+    auto delayed = [](std::vector<char>& payload) -> boost::asio::awaitable<void>
+    {
+        if (!payload.empty() && payload.front() == 's')
+        {
+            boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, std::chrono::milliseconds(1) };
+            co_await timer.async_wait(boost::asio::deferred);
+        }
+    };
+
+    auto fast = static_cast<std::size_t>(state.arg());
+    std::uint64_t overtaken = 0;
+
+    auto frame = [](std::uint32_t id, char tag)
+    {
+        return std::array<char, echo_server::mux::HeaderSize + 1>{ 0, 1, char(id >> 24), char(id >> 16), char(id >> 8), char(id), tag };
+    };
+
+    boost::asio::io_context client;
+    boost::asio::co_spawn(client, [&]() -> boost::asio::awaitable<void>
+    {
+        auto path = socket_path("mux");
+        boost::asio::local::stream_protocol::acceptor acceptor{ server, boost::asio::local::stream_protocol::endpoint{ path } };
+
+        boost::asio::local::stream_protocol::socket s{ co_await boost::asio::this_coro::executor };
+        co_await s.async_connect(acceptor.local_endpoint(), boost::asio::deferred);
+
+        boost::asio::co_spawn(boost::asio::make_strand(server), echo_server::mux::client_handler(acceptor.accept(), fast + 1, delayed), boost::asio::detached);
+        std::filesystem::remove(path);
+
+        std::vector<std::array<char, echo_server::mux::HeaderSize + 1>> requests;
+        requests.push_back(frame(0, 's'));
+        for (std::size_t i = 1; i <= fast; ++i)
+            requests.push_back(frame(std::uint32_t(i), 'f'));
+
+        std::array<char, echo_server::mux::HeaderSize + 1> reply;
+
+        state.resetTimer();
+
+        for (std::uint64_t i = 0; i < state.iterations(); ++i)
+        {
+            co_await boost::asio::async_write(s, boost::asio::buffer(requests.data(), requests.size() * reply.size()), boost::asio::deferred);
+
+            for (std::size_t r = 0; r <= fast; ++r)
+            {
+                co_await boost::asio::async_read(s, boost::asio::buffer(reply), boost::asio::deferred);
+                if (reply[6] == 's')
+                    overtaken += r;
+            }
+        }
+    }, boost::asio::detached);
+
+    client.run();
+
+    work.reset();
+    server.stop();
+    t.join();
+
+    cxx_coro::setTracer(std::move(tracer));
+
+    state.setItemsProcessed(state.iterations() * (fast + 1));
+    state.setCounter("fast_before_slow", double(overtaken) / double(state.iterations()));
+}
+
+
+void tcp_round_trip(cxx_coro::bench::State& state)
+{
+    transport_round_trip(state, 1, tcp_loopback);
+}
+
+void unix_round_trip(cxx_coro::bench::State& state)
+{
+    transport_round_trip(state, 1, unix_socket);
+}
+
+void shm_round_trip(cxx_coro::bench::State& state)
+{
+    transport_round_trip(state, 1, shared_memory);
+}
+
+void tcp_pipelined(cxx_coro::bench::State& state)
+{
+    transport_round_trip(state, 16, tcp_loopback);
+}
+
+void unix_pipelined(cxx_coro::bench::State& state)
+{
+    transport_round_trip(state, 16, unix_socket);
+}
+
+void shm_pipelined(cxx_coro::bench::State& state)
+{
+    transport_round_trip(state, 16, shared_memory);
+}
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(tcp_round_trip, { 64, 4096 });
+CXX_CORO_BENCHMARK(unix_round_trip, { 64, 4096 });
+CXX_CORO_BENCHMARK(shm_round_trip, { 64, 4096 });
+CXX_CORO_BENCHMARK(tcp_pipelined, { 64, 4096 });
+CXX_CORO_BENCHMARK(unix_pipelined, { 64, 4096 });
+CXX_CORO_BENCHMARK(shm_pipelined, { 64, 4096 });
+CXX_CORO_BENCHMARK(mux_slow_request, { 15 });
+
+#endif // CXX_CORO_LINUX
@@ -0,0 +1,100 @@
+#include "harness.hxx"
+
+#if CXX_CORO_LINUX
+
+#include "udp_echo_server.hxx"
+
+#include <algorithm>
+
+#include <sys/time.h>
+#include <thread>
+
+
+namespace
+{
+
+// Echoes state.iterations() datagrams through the server, keeping a window of them in flight
+// so the server sees several datagrams per wakeup, as under real load. Datagrams lost on
+// the loopback are not resent; the items/s figure counts echoes actually received, and
+// echoes that differ in size from what was sent are counted as mismatched.
+template <typename _Spawn>
+void udp_round_trip(cxx_coro::bench::State& state, _Spawn spawn)
+{
+    constexpr std::size_t Window = 32;
+    constexpr std::size_t WindowBytes = 64 * 1024;   // well below the default socket buffers, so large datagrams are not dropped
+
+    boost::asio::io_context io;
+    boost::asio::ip::udp::socket server{ io, boost::asio::ip::udp::endpoint{ boost::asio::ip::make_address("127.0.0.1"), 0 } };
+    auto ep = server.local_endpoint();
+
+    spawn(io, std::move(server));
+    std::thread t{ [&io]() { io.run(); } };
+
+    boost::asio::io_context client_io;
+    boost::asio::ip::udp::socket client{ client_io, boost::asio::ip::udp::v4() };
+    client.connect(ep);
+
+    timeval timeout{ 0, 100'000 };
+    ::setsockopt(client.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::vector<char> out(static_cast<std::size_t>(state.arg()), 'x');
+    auto max_window = std::clamp<std::size_t>(WindowBytes / out.size(), 1, Window);
+    std::vector<char> in(echo_server::udp::MaxDatagram);
+
+    state.resetTimer();
+
+    std::uint64_t received = 0;
+    std::uint64_t mismatched = 0;
+    for (std::uint64_t done = 0; done < state.iterations(); )
+    {
+        auto window = std::min<std::uint64_t>(max_window, state.iterations() - done);
+
+        for (std::uint64_t i = 0; i < window; ++i)
+            ::send(client.native_handle(), out.data(), out.size(), 0);
+
+        for (std::uint64_t i = 0; i < window; ++i)
+        {
+            auto n = ::recv(client.native_handle(), in.data(), in.size(), 0);
+            if (n < 0)
+                break; // the rest of the window was dropped
+
+            ++received;
+            if (static_cast<std::size_t>(n) != out.size())
+                ++mismatched;
+        }
+
+        done += window;
+    }
+
+    io.stop();
+    t.join();
+
+    state.setItemsProcessed(received);
+    state.setBytesProcessed(received * out.size());
+    state.setCounter("lost", double(state.iterations() - received));
+    state.setCounter("mismatched", double(mismatched));
+}
+
+void udp_async_receive_from(cxx_coro::bench::State& state)
+{
+    udp_round_trip(state, [](boost::asio::io_context& io, boost::asio::ip::udp::socket s)
+    {
+        boost::asio::co_spawn(io, echo_server::udp::simple_echo(std::move(s)), boost::asio::detached);
+    });
+}
+
+void udp_recvmmsg(cxx_coro::bench::State& state)
+{
+    udp_round_trip(state, [](boost::asio::io_context& io, boost::asio::ip::udp::socket s)
+    {
+        boost::asio::co_spawn(io, echo_server::udp::batch_echo(std::move(s), echo_server::udp::options{}), boost::asio::detached);
+    });
+}
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(udp_async_receive_from, { 64, 1024, 8192 });
+CXX_CORO_BENCHMARK(udp_recvmmsg, { 64, 1024, 8192 });
+
+#endif // CXX_CORO_LINUX
@@ -0,0 +1,200 @@
+#include "harness.hxx"
+#include "cancel.hxx"
+#include "proxy_server.hxx"
+#include "virtual_time.hxx"
+
+#include <array>
+
+
+namespace
+{
+
+using namespace std::chrono_literals;
+using virtual_time::virtual_clock;
+using virtual_time::virtual_timer;
+
+// All cases run on virtual time, so they measure the CPU cost of the scheduling logic: a run
+// that covers minutes of timeouts finishes as soon as the handlers are done. The clock is
+// process-wide and never goes back; every run starts where the previous one left it, which is
+// why deadlines are computed from virtual_clock::now() rather than from zero.
+
+double seconds(virtual_clock::duration d)
+{
+    return std::chrono::duration<double>(d).count();
+}
+
+boost::asio::awaitable<void> sleeper(std::uint32_t seed, std::uint64_t rounds)
+{
+    virtual_timer timer{ co_await boost::asio::this_coro::executor };
+
+    for (std::uint64_t i = 0; i < rounds; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        timer.expires_after(std::chrono::milliseconds(1 + seed % 1000));
+        co_await timer.async_wait(boost::asio::deferred);
+    }
+}
+
+// state.arg() coroutines share state.iterations() sleeps of 1 ms .. 1 s
+void virtual_sleep(cxx_coro::bench::State& state)
+{
+    auto n = std::min<std::uint64_t>(static_cast<std::uint64_t>(state.arg()), state.iterations());
+
+    boost::asio::io_context io;
+    for (std::uint64_t i = 0; i < n; ++i)
+        boost::asio::co_spawn(io, sleeper(std::uint32_t(i), state.iterations() / n + (i < state.iterations() % n)), boost::asio::detached);
+
+    auto started = virtual_clock::now();
+    state.resetTimer();
+
+    virtual_time::run(io);
+
+    state.setItemsProcessed(state.iterations());
+    state.setCounter("virtual_s", seconds(virtual_clock::now() - started));
+}
+
+// cancel.hxx's cancel() / run_for() pairs, state.arg() of them at a time, all timing out at the same instant
+void timeout_storm(cxx_coro::bench::State& state)
+{
+    for (std::uint64_t done = 0; done < state.iterations(); )
+    {
+        auto n = std::min<std::uint64_t>(static_cast<std::uint64_t>(state.arg()), state.iterations() - done);
+
+        boost::asio::io_context io;
+        std::vector<virtual_timer> timers;
+        timers.reserve(n);
+
+        for (std::uint64_t i = 0; i < n; ++i)
+        {
+            auto& timer = timers.emplace_back(io, virtual_timer::time_point::max());
+            boost::asio::co_spawn(io, cancellable::cancel(timer), boost::asio::detached);
+            boost::asio::co_spawn(io, cancellable::run_for(timer, 5s), boost::asio::detached);
+        }
+
+        virtual_time::run(io);
+
+        done += n;
+    }
+
+    state.setItemsProcessed(state.iterations());
+}
+
+
+// Idle timeouts for state.arg() connections, like proxy_server's: traffic on a connection pushes its
+// deadline out by IdleTimeout. Every tick one of Groups groups of connections sees traffic, for
+// state.iterations() ticks; then the traffic stops and every connection times out.
+constexpr auto IdleTimeout = 5s;
+constexpr auto Tick = 100ms;
+constexpr std::size_t Groups = 20;
+
+boost::asio::awaitable<void> traffic(std::vector<virtual_clock::time_point>& deadlines, std::uint64_t ticks)
+{
+    virtual_timer timer{ co_await boost::asio::this_coro::executor };
+
+    for (std::uint64_t t = 0; t < ticks; ++t)
+    {
+        auto deadline = virtual_clock::now() + IdleTimeout;
+        for (auto i = t % Groups; i < deadlines.size(); i += Groups)
+            deadlines[i] = deadline;
+
+        timer.expires_after(Tick);
+        co_await timer.async_wait(boost::asio::deferred);
+    }
+}
+
+// one timer per connection: proxy_server's own watchdog
+boost::asio::awaitable<void> watchdog(virtual_clock::time_point& deadline, std::size_t& expired)
+{
+    co_await proxy_server::watchdog<virtual_timer>(deadline);
+
+    ++expired;
+}
+
+// One timer for all connections: a hashed timer wheel with a slot per tick. A connection sits in the
+// slot of its deadline; when the slot comes round it either expires or moves to the slot of its new deadline.
+boost::asio::awaitable<void> wheel(std::vector<virtual_clock::time_point>& deadlines, std::size_t& expired)
+{
+    constexpr std::size_t Slots = 64;
+
+    std::array<std::vector<std::uint32_t>, Slots> slots;
+    auto slot_of = [](virtual_clock::time_point t)
+    {
+        return static_cast<std::size_t>(t.time_since_epoch() / Tick) % Slots;
+    };
+
+    for (std::uint32_t i = 0; i < deadlines.size(); ++i)
+        slots[slot_of(deadlines[i])].push_back(i);
+
+    virtual_timer timer{ co_await boost::asio::this_coro::executor };
+    std::vector<std::uint32_t> due;
+
+    for (auto live = deadlines.size(); live > 0; )
+    {
+        timer.expires_after(Tick);
+        co_await timer.async_wait(boost::asio::deferred);
+
+        auto now = virtual_clock::now();
+        due.clear();
+        std::swap(due, slots[slot_of(now)]);
+
+        for (auto i : due)
+        {
+            if (deadlines[i] <= now)
+            {
+                ++expired;
+                --live;
+            }
+            else
+            {
+                slots[slot_of(deadlines[i])].push_back(i);
+            }
+        }
+    }
+}
+
+template <bool _Wheel>
+void idle_deadlines(cxx_coro::bench::State& state)
+{
+    auto n = static_cast<std::size_t>(state.arg());
+    std::vector<virtual_clock::time_point> deadlines(n, virtual_clock::now() + IdleTimeout);
+    std::size_t expired = 0;
+
+    boost::asio::io_context io;
+    boost::asio::co_spawn(io, traffic(deadlines, state.iterations()), boost::asio::detached);
+
+    if constexpr (_Wheel)
+    {
+        boost::asio::co_spawn(io, wheel(deadlines, expired), boost::asio::detached);
+    }
+    else
+    {
+        for (auto& deadline : deadlines)
+            boost::asio::co_spawn(io, watchdog(deadline, expired), boost::asio::detached);
+    }
+
+    state.resetTimer();
+
+    virtual_time::run(io);
+
+    cxx_coro::bench::doNotOptimize(expired);
+    state.setItemsProcessed(state.iterations());
+    state.setCounter("expired", double(expired));
+}
+
+void deadline_timers(cxx_coro::bench::State& state)
+{
+    idle_deadlines<false>(state);
+}
+
+void deadline_wheel(cxx_coro::bench::State& state)
+{
+    idle_deadlines<true>(state);
+}
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(virtual_sleep, { 1000, 100000 });
+CXX_CORO_BENCHMARK(timeout_storm, { 1000, 100000 });
+CXX_CORO_BENCHMARK(deadline_timers, { 1000, 100000 });
+CXX_CORO_BENCHMARK(deadline_wheel, { 1000, 100000 });
@@ -0,0 +1,92 @@
+#include "harness.hxx"
+#include "work_stealing.hxx"
+
+#include <future>
+#include <latch>
+
+
+namespace
+{
+
+// a coroutine running on the pool hops into a serializing executor and back
+boost::asio::awaitable<void> hop(auto serial, std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; ++i)
+    {
+        co_await boost::asio::dispatch(boost::asio::bind_executor(serial, boost::asio::deferred));
+        co_await boost::asio::dispatch(boost::asio::deferred);
+    }
+}
+
+void run_hops(cxx_coro::bench::State& state, auto ex, auto serial)
+{
+    std::promise<void> done;
+
+    boost::asio::co_spawn(ex, hop(serial, state.iterations()), [&done](std::exception_ptr) { done.set_value(); });
+
+    done.get_future().wait();
+
+    state.setItemsProcessed(state.iterations());
+}
+
+void hop_thread_pool(cxx_coro::bench::State& state)
+{
+    boost::asio::thread_pool pool(static_cast<std::size_t>(state.arg()));
+
+    run_hops(state, pool.get_executor(), boost::asio::make_strand(pool));
+}
+
+void hop_work_stealing(cxx_coro::bench::State& state)
+{
+    work_stealing::work_stealing_pool pool(static_cast<std::size_t>(state.arg()));
+
+    run_hops(state, pool.get_executor(), work_stealing::make_serial(pool.get_executor()));
+}
+
+
+// one task running on the pool posts many small tasks back to it
+void run_fan_out(cxx_coro::bench::State& state, auto ex)
+{
+    auto n = state.iterations();
+    std::atomic<std::uint64_t> left = n;
+    std::latch done{ 1 };
+
+    boost::asio::post(ex, [&, ex]()
+    {
+        for (std::uint64_t i = 0; i < n; ++i)
+        {
+            boost::asio::post(ex, [&]()
+            {
+                if (left.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    done.count_down();
+            });
+        }
+    });
+
+    done.wait();
+
+    state.setItemsProcessed(n);
+}
+
+void fan_out_thread_pool(cxx_coro::bench::State& state)
+{
+    boost::asio::thread_pool pool(static_cast<std::size_t>(state.arg()));
+
+    run_fan_out(state, pool.get_executor());
+}
+
+void fan_out_work_stealing(cxx_coro::bench::State& state)
+{
+    work_stealing::work_stealing_pool pool(static_cast<std::size_t>(state.arg()));
+
+    run_fan_out(state, pool.get_executor());
+}
+
+
+} // namespace {}
+
+
+CXX_CORO_BENCHMARK(hop_thread_pool, { 1, 4 });
+CXX_CORO_BENCHMARK(hop_work_stealing, { 1, 4 });
+CXX_CORO_BENCHMARK(fan_out_thread_pool, { 1, 4 });
+CXX_CORO_BENCHMARK(fan_out_work_stealing, { 1, 4 });
@@ -0,0 +1,207 @@
+// Measures request latency against an in-process echo_server with and without busy polling,
+// and how much CPU the server thread burns for it.
+//
+//   busy_poll_latency [--requests=N] [--size=bytes] [--interval=us] [--spin=us] [--busy-poll=us] [--cpus=server,client]
+//
+// One blocking client sends a message, waits for the echo and then pauses for --interval, so the
+// server runs out of work between requests: exactly the case where run() goes to sleep in epoll and
+// the next request pays for the wakeup. The first CPU in --cpus is the server's, the second the client's.
+
+#include "echo_server.hxx"
+#include "run_mode.hxx"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+std::uint64_t threadCpuNs(pthread_t thread)
+{
+    clockid_t id;
+    if (::pthread_getcpuclockid(thread, &id) != 0)
+        return 0;
+
+    timespec ts{};
+    ::clock_gettime(id, &ts);
+
+    return std::uint64_t(ts.tv_sec) * 1'000'000'000 + std::uint64_t(ts.tv_nsec);
+}
+
+void pause(std::chrono::microseconds interval)
+{
+    if (interval.count() > 0)
+        std::this_thread::sleep_for(interval);
+}
+
+boost::asio::awaitable<void> accept_all(boost::asio::ip::tcp::acceptor& acceptor)
+{
+    auto executor{ co_await boost::asio::this_coro::executor };
+
+    for (;;)
+    {
+        boost::asio::ip::tcp::socket socket{ co_await acceptor.async_accept(boost::asio::deferred) };
+        socket.set_option(boost::asio::ip::tcp::no_delay(true));
+
+        boost::asio::co_spawn(executor, echo_server::client_handler(std::move(socket)), boost::asio::detached);
+    }
+}
+
+std::uint64_t percentile(const std::vector<std::uint64_t>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * double(sorted.size())))];
+}
+
+void usage(char* self)
+{
+    std::cout << std::format("Usage: {} [--requests=N] [--size=bytes] [--interval=us] {}\n", self, cxx_coro::run_mode::usage);
+}
+
+} // namespace {}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t requests = 20'000;
+    std::size_t size = 64;
+    std::chrono::microseconds interval{ 50 };
+    cxx_coro::run_mode::options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view a{ argv[i] };
+
+        if (a.starts_with("--requests="))
+        {
+            auto n = cxx_coro::run_mode::parse_number<std::size_t>(a.substr(11));
+            if (!n || !*n)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            requests = *n;
+        }
+        else if (a.starts_with("--size="))
+        {
+            auto n = cxx_coro::run_mode::parse_number<std::size_t>(a.substr(7));
+            if (!n)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            size = std::min<std::size_t>(*n, 65535);
+        }
+        else if (a.starts_with("--interval="))
+        {
+            auto us = cxx_coro::run_mode::parse_number<std::uint32_t>(a.substr(11));
+            if (!us)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            interval = std::chrono::microseconds(*us);
+        }
+        else if (!cxx_coro::run_mode::parse_option(a, options))
+        {
+            usage(argv[0]);
+            return a == "-h" || a == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    // keep all logging out of the measurement
+    cxx_coro::setTracer([](cxx_coro::Level, std::uint32_t, std::string_view) {});
+
+    boost::asio::io_context io{ 1 };
+    boost::asio::ip::tcp::acceptor acceptor{ io, boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), 0 } };
+    cxx_coro::run_mode::set_busy_poll(acceptor, options.busy_poll);
+    auto ep = acceptor.local_endpoint();
+
+    boost::asio::co_spawn(io, accept_all(acceptor), boost::asio::detached);
+
+    auto work = boost::asio::make_work_guard(io);
+    std::thread server{ [&io, &options]() { cxx_coro::run_mode::run(io, options, 1); } };
+
+    if (options.cpus.size() > 1 && !cxx_coro::run_mode::pin_thread(options.cpus[1]))
+        std::cout << std::format("failed to pin the client to CPU {}\n", options.cpus[1]);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (::connect(fd, ep.data(), ep.size()) < 0)
+    {
+        std::cout << std::format("connect failed: {}\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    std::vector<char> message(2 + size, 'x');
+    message[0] = char(size >> 8);
+    message[1] = char(size & 0xff);
+    std::vector<char> reply(message.size());
+
+    std::vector<std::uint64_t> latencies;
+    latencies.reserve(requests);
+
+    auto cpuBefore = threadCpuNs(server.native_handle());
+    auto started = cxx_coro::metrics::now();
+
+    for (std::size_t i = 0; i < requests; ++i)
+    {
+        auto t = cxx_coro::metrics::now();
+
+        if (::send(fd, message.data(), message.size(), 0) != ssize_t(message.size()))
+            break;
+
+        std::size_t got = 0;
+        while (got < reply.size())
+        {
+            auto n = ::recv(fd, reply.data() + got, reply.size() - got, 0);
+            if (n <= 0)
+                break;
+
+            got += std::size_t(n);
+        }
+
+        if (got < reply.size())
+            break;
+
+        latencies.push_back(cxx_coro::metrics::now() - t);
+
+        pause(interval);
+    }
+
+    auto elapsed = cxx_coro::metrics::now() - started;
+    auto cpu = threadCpuNs(server.native_handle()) - cpuBefore;
+
+    ::close(fd);
+    work.reset();
+    io.stop();
+    server.join();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << std::format("spin:            {} us\n", options.spin.count());
+    std::cout << std::format("SO_BUSY_POLL:    {} us\n", options.busy_poll);
+    std::cout << std::format("requests:        {}\n", latencies.size());
+    std::cout << std::format("interval:        {} us\n", interval.count());
+    std::cout << std::format("p50:             {:.1f} us\n", double(percentile(latencies, 0.5)) / 1000.0);
+    std::cout << std::format("p99:             {:.1f} us\n", double(percentile(latencies, 0.99)) / 1000.0);
+    std::cout << std::format("p99.9:           {:.1f} us\n", double(percentile(latencies, 0.999)) / 1000.0);
+    std::cout << std::format("server CPU:      {:.0f}%\n", elapsed ? 100.0 * double(cpu) / double(elapsed) : 0.0);
+
+    return 0;
+}
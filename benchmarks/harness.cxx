@@ -0,0 +1,258 @@
+#include "harness.hxx"
+#include "run_mode.hxx"
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+
+namespace cxx_coro
+{
+
+namespace bench
+{
+
+namespace
+{
+
+struct Case
+{
+    std::string name;
+    BenchmarkFn fn;
+    std::int64_t arg;
+};
+
+std::vector<Case>& cases()
+{
+    static std::vector<Case> c;
+    return c;
+}
+
+struct Result
+{
+    std::string name;
+    std::uint64_t iterations = 0;
+    double real_time = 0; // ns per iteration
+    double cpu_time = 0;  // ns per iteration, all threads of the process
+    double items_per_second = 0;
+    double bytes_per_second = 0;
+    std::map<std::string, double> counters;
+};
+
+struct Options
+{
+    std::string filter;
+    std::string json;
+    double min_time = 0.5;
+};
+
+} // namespace {}
+
+
+struct Runner
+{
+    static Result measure(const Case& c, std::uint64_t iterations)
+    {
+        State state{ iterations, c.arg };
+
+        state.resetTimer();
+
+        c.fn(state);
+
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - state.start_).count();
+        auto cpu = 1e9 * double(std::clock() - state.cpu_start_) / CLOCKS_PER_SEC;
+
+        Result r;
+        r.name = c.name;
+        r.iterations = iterations;
+        r.real_time = elapsed / double(iterations);
+        r.cpu_time = cpu / double(iterations);
+
+        if (state.items_)
+            r.items_per_second = double(state.items_) * 1e9 / elapsed;
+        if (state.bytes_)
+            r.bytes_per_second = double(state.bytes_) * 1e9 / elapsed;
+
+        r.counters = std::move(state.counters_);
+
+        return r;
+    }
+
+    static Result run(const Case& c, double min_time)
+    {
+        std::uint64_t iterations = 1;
+
+        for (;;)
+        {
+            auto r = measure(c, iterations);
+            auto total = r.real_time * double(iterations) / 1e9;
+
+            if (total >= min_time || iterations >= 1'000'000'000)
+                return r;
+
+            // aim a bit past the target, but never grow by more than 10x at once
+            auto next = total > 0 ? double(iterations) * min_time * 1.4 / total : double(iterations) * 10;
+            next = std::min(next, double(iterations) * 10);
+            iterations = std::max<std::uint64_t>(iterations + 1, static_cast<std::uint64_t>(next));
+        }
+    }
+};
+
+
+Registrar::Registrar(std::string_view name, BenchmarkFn fn, std::vector<std::int64_t> args)
+{
+    if (args.empty())
+    {
+        cases().push_back(Case{ std::string(name), std::move(fn), 0 });
+        return;
+    }
+
+    for (auto arg : args)
+        cases().push_back(Case{ std::format("{}/{}", name, arg), fn, arg });
+}
+
+
+namespace
+{
+
+void writeJson(std::ostream& out, const char* executable, const std::vector<Result>& results)
+{
+    char date[64] = {};
+    auto t = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&t));
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"executable\": \"" << executable << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\"\n"
+#else
+        << "    \"library_build_type\": \"debug\"\n"
+#endif
+        << "  },\n  \"benchmarks\": [";
+
+    bool first = true;
+    for (auto& r : results)
+    {
+        if (!first)
+            out << ',';
+        first = false;
+
+        out << "\n    {\n"
+            << "      \"name\": \"" << r.name << "\",\n"
+            << "      \"run_name\": \"" << r.name << "\",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << r.real_time << ",\n"
+            << "      \"cpu_time\": " << r.cpu_time << ",\n";
+
+        if (r.items_per_second > 0)
+            out << "      \"items_per_second\": " << r.items_per_second << ",\n";
+        if (r.bytes_per_second > 0)
+            out << "      \"bytes_per_second\": " << r.bytes_per_second << ",\n";
+
+        for (auto& [name, value] : r.counters)
+            out << "      \"" << name << "\": " << value << ",\n";
+
+        out << "      \"time_unit\": \"ns\"\n    }";
+    }
+
+    out << "\n  ]\n}\n";
+}
+
+void usage(char* self)
+{
+    std::cout << std::format("Usage: {} [--filter=substring] [--min-time=seconds] [--json=file|-]\n", self);
+}
+
+} // namespace {}
+
+
+int run(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view a{ argv[i] };
+
+        if (a == "-h" || a == "--help")
+        {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        }
+        else if (a.starts_with("--filter="))
+        {
+            options.filter = a.substr(9);
+        }
+        else if (a.starts_with("--json="))
+        {
+            options.json = a.substr(7);
+        }
+        else if (a.starts_with("--min-time="))
+        {
+            auto seconds = run_mode::parse_number<double>(a.substr(11));
+            if (!seconds || !std::isfinite(*seconds) || *seconds < 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            options.min_time = *seconds;
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Result> results;
+
+    // with the JSON on stdout the table goes to stderr, so that stdout stays parseable
+    std::ostream& table = options.json == "-" ? std::cerr : std::cout;
+
+    table << std::format("{:<48} {:>14} {:>14} {:>14} {:>16}\n", "benchmark", "time ns", "cpu ns", "iterations", "items/s");
+
+    for (auto& c : cases())
+    {
+        if (!options.filter.empty() && c.name.find(options.filter) == std::string::npos)
+            continue;
+
+        auto r = Runner::run(c, options.min_time);
+
+        table << std::format("{:<48} {:>14.1f} {:>14.1f} {:>14} {:>16.0f}", r.name, r.real_time, r.cpu_time, r.iterations, r.items_per_second);
+        for (auto& [name, value] : r.counters)
+            table << std::format(" {}={:.0f}", name, value);
+        table << std::endl;
+
+        results.push_back(std::move(r));
+    }
+
+    if (options.json == "-")
+    {
+        writeJson(std::cout, argv[0], results);
+    }
+    else if (!options.json.empty())
+    {
+        std::ofstream out{ options.json };
+        if (!out)
+        {
+            std::cerr << "Failed to open " << options.json << "\n";
+            return EXIT_FAILURE;
+        }
+
+        writeJson(out, argv[0], results);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+} // namespace bench {}
+
+} // namespace cxx_coro {}
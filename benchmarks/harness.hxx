@@ -0,0 +1,107 @@
+#pragma once
+
+#include "common.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace cxx_coro
+{
+
+namespace bench
+{
+
+// A minimal benchmark harness. Each case is called with a State holding the iteration count to run;
+// the harness grows the count until a run takes at least --min-time. Results are printed as a table
+// and optionally written as Google Benchmark compatible JSON (--json=file), so the usual comparison tools work.
+class State
+{
+public:
+    State(std::uint64_t iterations, std::int64_t arg) noexcept
+        : iterations_(iterations)
+        , arg_(arg)
+    {
+    }
+
+    std::uint64_t iterations() const noexcept
+    {
+        return iterations_;
+    }
+
+    std::int64_t arg() const noexcept
+    {
+        return arg_;
+    }
+
+    // call after expensive setup to exclude it from the measurement
+    void resetTimer() noexcept
+    {
+        start_ = std::chrono::steady_clock::now();
+        cpu_start_ = std::clock();
+    }
+
+    // items processed in total; reported as items_per_second
+    void setItemsProcessed(std::uint64_t items) noexcept
+    {
+        items_ = items;
+    }
+
+    void setBytesProcessed(std::uint64_t bytes) noexcept
+    {
+        bytes_ = bytes;
+    }
+
+    // extra named values reported as is, e.g. latency percentiles
+    void setCounter(std::string_view name, double value)
+    {
+        counters_[std::string(name)] = value;
+    }
+
+private:
+    friend struct Runner;
+
+    std::uint64_t iterations_;
+    std::int64_t arg_;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    std::clock_t cpu_start_ = std::clock();     // process CPU time, all threads, at start_
+    std::uint64_t items_ = 0;
+    std::uint64_t bytes_ = 0;
+    std::map<std::string, double> counters_;
+};
+
+
+using BenchmarkFn = std::function<void(State&)>;
+
+struct Registrar
+{
+    Registrar(std::string_view name, BenchmarkFn fn, std::vector<std::int64_t> args = {});
+};
+
+
+template <typename _T>
+inline void doNotOptimize(_T const& value)
+{
+#if defined __clang__ || defined __GNUC__
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char const* sink;
+    sink = reinterpret_cast<char const volatile*>(&value);
+#endif
+}
+
+int run(int argc, char** argv);
+
+} // namespace bench {}
+
+} // namespace cxx_coro {}
+
+
+#define CXX_CORO_BENCHMARK(fn, ...) \
+    static ::cxx_coro::bench::Registrar fn##_registrar{ #fn, fn, ##__VA_ARGS__ }
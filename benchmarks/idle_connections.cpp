@@ -0,0 +1,229 @@
+// Opens many loopback connections to an in-process echo_server, exchanges one message on each
+// and then leaves them idle, reporting how much the resident set grew per connection.
+//
+//   idle_connections [--count=N] [--size=bytes] [--idle]
+//
+// The client ends are plain file descriptors, so practically all of the growth is the server side:
+// coroutine frames, sockets, reactor state and whatever buffers the handler keeps. Kernel socket
+// memory does not show up in RSS.
+
+#include "echo_server.hxx"
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+// one listening port per this many connections, to stay well within the ephemeral port range
+constexpr std::size_t ConnectionsPerPort = 25000;
+
+
+std::size_t residentBytes()
+{
+    std::ifstream statm{ "/proc/self/statm" };
+    std::size_t size = 0;
+    std::size_t resident = 0;
+    statm >> size >> resident;
+
+    return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+// each connection costs two descriptors here, the client's and the server's
+std::size_t raiseFileLimit(std::size_t wanted)
+{
+    rlimit rl{};
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+
+    std::size_t nr_open = 1024 * 1024;
+    std::ifstream{ "/proc/sys/fs/nr_open" } >> nr_open;
+
+    rlimit raised{ std::min<rlim_t>(wanted, nr_open), std::min<rlim_t>(std::max<rlim_t>(wanted, rl.rlim_max), nr_open) };
+    if (::setrlimit(RLIMIT_NOFILE, &raised) == 0)
+        return raised.rlim_cur;
+
+    // not privileged: the hard limit is as far as we can go
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+    return rl.rlim_cur;
+}
+
+boost::asio::awaitable<void> accept_all(boost::asio::ip::tcp::acceptor& acceptor, bool idle, std::atomic<std::size_t>& accepted)
+{
+    auto executor{ co_await boost::asio::this_coro::executor };
+
+    for (;;)
+    {
+        boost::asio::ip::tcp::socket socket{ co_await acceptor.async_accept(boost::asio::deferred) };
+        accepted.fetch_add(1, std::memory_order_relaxed);
+
+        if (idle)
+            boost::asio::co_spawn(executor, echo_server::idle_client_handler(std::move(socket)), boost::asio::detached);
+        else
+            boost::asio::co_spawn(executor, echo_server::client_handler(std::move(socket)), boost::asio::detached);
+    }
+}
+
+bool exchange(int fd, const std::vector<char>& message, std::vector<char>& reply)
+{
+    if (::send(fd, message.data(), message.size(), 0) != ssize_t(message.size()))
+        return false;
+
+    std::size_t got = 0;
+    while (got < reply.size())
+    {
+        auto n = ::recv(fd, reply.data() + got, reply.size() - got, 0);
+        if (n <= 0)
+            return false;
+
+        got += std::size_t(n);
+    }
+
+    return true;
+}
+
+void usage(char* self)
+{
+    std::cout << std::format("Usage: {} [--count=N] [--size=bytes] [--idle]\n", self);
+}
+
+} // namespace {}
+
+
+int main(int argc, char** argv)
+{
+    std::size_t count = 100'000;
+    std::size_t size = 1024;
+    bool idle = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view a{ argv[i] };
+
+        if (a.starts_with("--count="))
+        {
+            auto n = cxx_coro::run_mode::parse_number<std::size_t>(a.substr(8));
+            if (!n || !*n)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            count = *n;
+        }
+        else if (a.starts_with("--size="))
+        {
+            auto n = cxx_coro::run_mode::parse_number<std::size_t>(a.substr(7));
+            if (!n)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+
+            size = std::min<std::size_t>(*n, 65535);
+        }
+        else if (a == "--idle")
+        {
+            idle = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return a == "-h" || a == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    // 64 descriptors are left for the listeners, the reactor and stdio
+    auto limit = raiseFileLimit(2 * count + 64);
+    if (limit < 2 * count + 64)
+    {
+        count = limit > 64 ? (limit - 64) / 2 : 0;
+        if (!count)
+        {
+            std::cerr << std::format("RLIMIT_NOFILE is {}, too low to open any connection\n", limit);
+            return EXIT_FAILURE;
+        }
+
+        std::cout << std::format("RLIMIT_NOFILE is {}, opening {} connections only\n", limit, count);
+    }
+
+    // keep all logging out of the measurement
+    cxx_coro::setTracer([](cxx_coro::Level, std::uint32_t, std::string_view) {});
+
+    boost::asio::io_context io{ 1 };
+    std::atomic<std::size_t> accepted = 0;
+
+    std::vector<std::unique_ptr<boost::asio::ip::tcp::acceptor>> acceptors;
+    std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+    for (std::size_t i = 0; i < (count + ConnectionsPerPort - 1) / ConnectionsPerPort; ++i)
+    {
+        auto& a = acceptors.emplace_back(std::make_unique<boost::asio::ip::tcp::acceptor>(io, boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), 0 }));
+        endpoints.push_back(a->local_endpoint());
+
+        boost::asio::co_spawn(io, accept_all(*a, idle, accepted), boost::asio::detached);
+    }
+
+    std::vector<int> clients;
+    clients.reserve(count);
+    std::vector<char> message(2 + size, 'x');
+    message[0] = char(size >> 8);
+    message[1] = char(size & 0xff);
+    std::vector<char> reply(message.size());
+
+    auto work = boost::asio::make_work_guard(io);
+    std::thread server{ [&io]() { io.run(); } };
+
+    // let the server thread settle before taking the baseline
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto before = residentBytes();
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto& ep = endpoints[i / ConnectionsPerPort];
+
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, ep.data(), ep.size()) < 0 || !exchange(fd, message, reply))
+        {
+            std::cout << std::format("connection #{} failed: {}\n", i, strerror(errno));
+            if (fd >= 0)
+                ::close(fd);
+
+            count = i;
+            break;
+        }
+
+        clients.push_back(fd);
+    }
+
+    while (accepted.load(std::memory_order_relaxed) < count)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    auto after = residentBytes();
+
+    std::cout << std::format("mode:            {}\n", idle ? "idle" : "default");
+    std::cout << std::format("connections:     {}\n", count);
+    std::cout << std::format("message size:    {}\n", size);
+    std::cout << std::format("RSS before:      {} KiB\n", before / 1024);
+    std::cout << std::format("RSS after:       {} KiB\n", after / 1024);
+    if (count)
+        std::cout << std::format("per connection:  {} bytes\n", (after - before) / count);
+
+    for (auto fd : clients)
+        ::close(fd);
+
+    work.reset();
+    io.stop();
+    server.join();
+
+    return count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
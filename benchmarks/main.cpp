@@ -0,0 +1,8 @@
+#include "harness.hxx"
+
+
+
+int main(int argc, char** argv)
+{
+    return cxx_coro::bench::run(argc, argv);
+}
@@ -10,7 +10,9 @@
 namespace cancellable
 {
 
+// The timer type is a parameter so that the same code runs on virtual time (see virtual_time/).
 
+template <typename _Timer = boost::asio::system_timer>
 boost::asio::awaitable<void> periodic_work()
 {
     VerboseBlock("periodic_work()");
@@ -18,17 +20,18 @@ boost::asio::awaitable<void> periodic_work()
     for (;;)
     {
         std::cout << "Hello" << std::endl;
-        boost::asio::system_timer timer{ co_await boost::asio::this_coro::executor };
+        _Timer timer{ co_await boost::asio::this_coro::executor };
         timer.expires_after(std::chrono::seconds{ 1 });
         co_await timer.async_wait(boost::asio::use_awaitable);
     }
 }
 
-boost::asio::awaitable<void> run_for(boost::asio::system_timer& outer, std::chrono::milliseconds duration)
+template <typename _Timer>
+boost::asio::awaitable<void> run_for(_Timer& outer, std::chrono::milliseconds duration)
 {
     VerboseBlock("run_for()");
 
-    boost::asio::system_timer timer{ co_await boost::asio::this_coro::executor };
+    _Timer timer{ co_await boost::asio::this_coro::executor };
     timer.expires_after(duration);
     
     co_await timer.async_wait(boost::asio::use_awaitable);
@@ -37,7 +40,8 @@ boost::asio::awaitable<void> run_for(boost::asio::system_timer& outer, std::chro
     outer.cancel();
 }
 
-boost::asio::awaitable<void> cancel(boost::asio::system_timer& timer)
+template <typename _Timer>
+boost::asio::awaitable<void> cancel(_Timer& timer)
 {
     VerboseBlock("cancel()");
 
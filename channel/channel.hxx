@@ -0,0 +1,664 @@
+#pragma once
+
+#include "common.hxx"
+#include "generator.hxx"
+
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+
+#include <boost/asio.hpp>
+
+
+namespace channel
+{
+
+namespace detail
+{
+
+constexpr std::size_t CacheLine = 64;
+
+
+template <typename _T>
+struct slot
+{
+    alignas(_T) std::byte storage[sizeof(_T)];
+
+    _T* get() noexcept
+    {
+        return std::launder(reinterpret_cast<_T*>(storage));
+    }
+};
+
+
+// Single producer, single consumer ring. Each side keeps a private copy of the other side's
+// index and only reloads it when the ring looks full (empty), so in steady state push and pop
+// touch no cache line written by the other thread except the slot itself.
+template <typename _T>
+class spsc_ring
+{
+public:
+    ~spsc_ring()
+    {
+        for (auto head = head_.load(std::memory_order_relaxed); head != tail_.load(std::memory_order_relaxed); ++head)
+            slots_[head & mask_].get()->~_T();
+    }
+
+    explicit spsc_ring(std::size_t capacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1)
+        , slots_(new slot<_T>[mask_ + 1])
+    {
+    }
+
+    std::size_t capacity() const noexcept
+    {
+        return mask_ + 1;
+    }
+
+    // moves from v only on success
+    bool try_push(_T& v)
+    {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ > mask_)
+        {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ > mask_)
+                return false;
+        }
+
+        new (slots_[tail & mask_].storage) _T(std::move(v));
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<_T> try_pop()
+    {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_)
+        {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_)
+                return std::nullopt;
+        }
+
+        auto p = slots_[head & mask_].get();
+        std::optional<_T> v{ std::move(*p) };
+        p->~_T();
+
+        head_.store(head + 1, std::memory_order_release);
+        return v;
+    }
+
+    bool empty() const noexcept
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    bool full() const noexcept
+    {
+        return size() > mask_;
+    }
+
+    std::size_t size() const noexcept
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(CacheLine) std::atomic<std::size_t> head_ = 0;     // consumer
+    std::size_t cached_tail_ = 0;
+    alignas(CacheLine) std::atomic<std::size_t> tail_ = 0;     // producer
+    std::size_t cached_head_ = 0;
+    alignas(CacheLine) std::size_t mask_;
+    std::unique_ptr<slot<_T>[]> slots_;
+};
+
+
+// Bounded multi-producer, multi-consumer ring (D. Vyukov). Each cell carries a sequence number
+// telling whether it is free for the lap a producer or a consumer is on, so both sides claim
+// a position with one CAS and never wait for each other.
+template <typename _T>
+class mpmc_ring
+{
+public:
+    ~mpmc_ring()
+    {
+        while (try_pop())
+        {
+        }
+    }
+
+    explicit mpmc_ring(std::size_t capacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1)
+        , cells_(new cell[mask_ + 1])
+    {
+        for (std::size_t i = 0; i <= mask_; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    std::size_t capacity() const noexcept
+    {
+        return mask_ + 1;
+    }
+
+    // moves from v only on success
+    bool try_push(_T& v)
+    {
+        auto pos = tail_.load(std::memory_order_relaxed);
+        cell* c;
+        for (;;)
+        {
+            c = &cells_[pos & mask_];
+            auto seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (c->value.storage) _T(std::move(v));
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<_T> try_pop()
+    {
+        auto pos = head_.load(std::memory_order_relaxed);
+        cell* c;
+        for (;;)
+        {
+            c = &cells_[pos & mask_];
+            auto seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return std::nullopt; // empty
+            }
+            else
+            {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+
+        auto p = c->value.get();
+        std::optional<_T> v{ std::move(*p) };
+        p->~_T();
+
+        c->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return v;
+    }
+
+    bool empty() const noexcept
+    {
+        auto pos = head_.load(std::memory_order_acquire);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    bool full() const noexcept
+    {
+        auto pos = tail_.load(std::memory_order_acquire);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) != pos;
+    }
+
+    // approximate while other threads push or pop
+    std::size_t size() const noexcept
+    {
+        auto head = head_.load(std::memory_order_acquire);
+        auto tail = tail_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        slot<_T> value;
+    };
+
+    alignas(CacheLine) std::atomic<std::size_t> head_ = 0;
+    alignas(CacheLine) std::atomic<std::size_t> tail_ = 0;
+    alignas(CacheLine) std::size_t mask_;
+    std::unique_ptr<cell[]> cells_;
+};
+
+
+// What the channel posts: f applied to the handler it completes. It carries the handler's
+// associated executor, allocator and cancellation slot (see the associators below), so posting
+// it is like posting the handler itself, the way asio's own binders behave.
+template <typename _Handler, typename _F>
+struct bound_handler
+{
+    _Handler handler;
+    _F f;
+
+    void operator()()
+    {
+        std::move(f)(std::move(handler));
+    }
+};
+
+template <typename _Handler, typename _F>
+bound_handler<std::decay_t<_Handler>, std::decay_t<_F>> bind_handler(_Handler&& handler, _F&& f)
+{
+    return { std::forward<_Handler>(handler), std::forward<_F>(f) };
+}
+
+
+// A suspended send or receive. Waking it posts the operation back to the executor
+// associated with its handler, where it retries against the ring.
+struct waiter
+{
+    virtual ~waiter() = default;
+    virtual void wake() = 0;
+
+    waiter* next = nullptr;
+};
+
+
+template <typename _Handler, typename _Retry>
+struct parked_operation
+    : public waiter
+{
+    using executor_type = boost::asio::associated_executor_t<_Handler>;
+    using work_type = std::decay_t<decltype(boost::asio::prefer(std::declval<executor_type>(), boost::asio::execution::outstanding_work.tracked))>;
+
+    parked_operation(_Handler&& handler, _Retry&& retry)
+        : handler(std::move(handler))
+        , retry(std::move(retry))
+        , work(boost::asio::prefer(boost::asio::get_associated_executor(this->handler), boost::asio::execution::outstanding_work.tracked))
+    {
+    }
+
+    void wake() override
+    {
+        std::unique_ptr<parked_operation> self{ this };
+
+        auto ex = boost::asio::get_associated_executor(handler);
+        boost::asio::post(ex, bind_handler(std::move(handler), std::move(retry)));
+    }
+
+    _Handler handler;
+    _Retry retry;
+    work_type work;   // a parked receiver keeps its io_context running, just like a pending socket read
+};
+
+
+// FIFO of suspended operations. The atomic count lets the other side skip the mutex
+// entirely while nobody is waiting, which is the common case for a busy channel.
+class wait_list
+{
+public:
+    ~wait_list()
+    {
+        while (head_)
+            delete std::exchange(head_, head_->next);
+    }
+
+    wait_list() noexcept = default;
+
+    wait_list(const wait_list&) = delete;
+    wait_list& operator=(const wait_list&) = delete;
+
+    std::size_t waiting() const noexcept
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    void park(waiter* w) noexcept
+    {
+        std::lock_guard l{ lock_ };
+
+        w->next = nullptr;
+        if (tail_)
+            tail_->next = w;
+        else
+            head_ = w;
+        tail_ = w;
+
+        count_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void wake_one()
+    {
+        waiter* w = nullptr;
+
+        {
+            std::lock_guard l{ lock_ };
+
+            w = head_;
+            if (!w)
+                return;
+
+            head_ = w->next;
+            if (!head_)
+                tail_ = nullptr;
+
+            count_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        w->wake();
+    }
+
+    void wake_all()
+    {
+        waiter* w = nullptr;
+
+        {
+            std::lock_guard l{ lock_ };
+
+            w = std::exchange(head_, nullptr);
+            tail_ = nullptr;
+            count_.store(0, std::memory_order_relaxed);
+        }
+
+        while (w)
+            std::exchange(w, w->next)->wake();
+    }
+
+private:
+    std::mutex lock_;
+    waiter* head_ = nullptr;
+    waiter* tail_ = nullptr;
+    std::atomic<std::size_t> count_ = 0;
+};
+
+} // namespace detail {}
+
+
+// A bounded channel handing values from coroutines on one executor to coroutines on another.
+//
+// Values go through a lock-free ring; the mutex-guarded wait lists are only touched when a side
+// actually has to suspend. A suspended receiver is woken once, by the first send that finds it
+// parked, and takes everything sent until then without further notifications (see drain()),
+// so a busy pipeline pays for one post per batch rather than one per item. The same holds for
+// senders waiting for room.
+//
+// async_send() completes with broken_pipe once the channel is closed; async_receive() completes
+// with eof and a default-constructed value once it is closed and empty, hence the requirement on _T.
+template <typename _T, template <typename> class _Ring = detail::mpmc_ring>
+    requires std::default_initializable<_T>
+class async_channel
+{
+public:
+    using value_type = _T;
+
+    explicit async_channel(std::size_t capacity)
+        : ring_(capacity)
+    {
+    }
+
+    async_channel(const async_channel&) = delete;
+    async_channel& operator=(const async_channel&) = delete;
+
+    std::size_t capacity() const noexcept
+    {
+        return ring_.capacity();
+    }
+
+    bool is_closed() const noexcept
+    {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    // wakes everybody; values already in the channel can still be received
+    void close()
+    {
+        closed_.store(true, std::memory_order_seq_cst);
+
+        receivers_.wake_all();
+        senders_.wake_all();
+    }
+
+    // moves from v only on success
+    bool try_send(value_type& v)
+    {
+        if (is_closed() || !ring_.try_push(v))
+            return false;
+
+        notify(receivers_);
+        return true;
+    }
+
+    bool try_send(value_type&& v)
+    {
+        return try_send(v);
+    }
+
+    std::optional<value_type> try_receive()
+    {
+        auto v = ring_.try_pop();
+        if (v)
+            made_room();
+
+        return v;
+    }
+
+    template <typename _CompletionToken>
+    auto async_send(value_type v, _CompletionToken&& token)
+    {
+        auto init = [this](auto handler, value_type v)
+        {
+            send_impl(std::move(v), std::move(handler), false);
+        };
+
+        return boost::asio::async_initiate<_CompletionToken, void(boost::system::error_code)>(init, token, std::move(v));
+    }
+
+    template <typename _CompletionToken>
+    auto async_receive(_CompletionToken&& token)
+    {
+        auto init = [this](auto handler)
+        {
+            receive_impl(std::move(handler), false);
+        };
+
+        return boost::asio::async_initiate<_CompletionToken, void(boost::system::error_code, value_type)>(init, token);
+    }
+
+    // Coroutine front-ends: they suspend only when the ring is full (empty). Each call is still
+    // an awaitable frame, so hot loops do better calling try_send() first and send() on failure.
+    boost::asio::awaitable<bool> send(value_type v)
+    {
+        if (try_send(v))
+            co_return true;
+
+        boost::system::error_code ec;
+        co_await async_send(std::move(v), boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+
+        co_return !ec;
+    }
+
+    // std::nullopt once the channel is closed and empty
+    boost::asio::awaitable<std::optional<value_type>> receive()
+    {
+        if (auto v = try_receive())
+            co_return v;
+
+        boost::system::error_code ec;
+        auto v = co_await async_receive(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec)
+            co_return std::nullopt;
+
+        co_return std::optional<value_type>{ std::move(v) };
+    }
+
+    // sends everything a generator produces; false if the channel was closed before it ran out
+    boost::asio::awaitable<bool> send_all(generator<value_type> source)
+    {
+        while (auto v = source.next())
+        {
+            if (!co_await send(std::move(*v)))
+                co_return false;
+        }
+
+        co_return true;
+    }
+
+    // everything that can be received right now, without suspending
+    generator<value_type> drain()
+    {
+        while (auto v = try_receive())
+        {
+            co_yield std::move(*v);
+        }
+    }
+
+private:
+    // A parked sender is only woken once the ring has drained to half its capacity, so that it
+    // can push a batch of values when it runs instead of parking again after each one.
+    void made_room()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (senders_.waiting() && ring_.size() <= ring_.capacity() / 2)
+            senders_.wake_one();
+    }
+
+    void notify(detail::wait_list& waiters)
+    {
+        // pairs with the fence in send_impl()/receive_impl(): either we see the waiter or it sees our value
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.waiting())
+            waiters.wake_one();
+    }
+
+    template <typename _Handler>
+    void send_impl(value_type v, _Handler&& handler, bool resumed)
+    {
+        if (is_closed())
+        {
+            complete(std::move(handler), resumed, boost::system::error_code{ boost::asio::error::broken_pipe });
+            return;
+        }
+
+        if (ring_.try_push(v))
+        {
+            notify(receivers_);
+            complete(std::move(handler), resumed, boost::system::error_code{});
+            return;
+        }
+
+        auto retry = [this, v = std::move(v)](auto handler) mutable
+        {
+            send_impl(std::move(v), std::move(handler), true);
+        };
+
+        senders_.park(new detail::parked_operation<std::decay_t<_Handler>, decltype(retry)>(std::move(handler), std::move(retry)));
+
+        // a receiver may have made room (or the channel got closed) after try_push() failed but before we were parked
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ring_.full() || is_closed())
+            senders_.wake_one();
+    }
+
+    template <typename _Handler>
+    void receive_impl(_Handler&& handler, bool resumed)
+    {
+        if (auto v = ring_.try_pop())
+        {
+            made_room();
+            complete(std::move(handler), resumed, boost::system::error_code{}, std::move(*v));
+            return;
+        }
+
+        if (is_closed())
+        {
+            complete(std::move(handler), resumed, boost::system::error_code{ boost::asio::error::eof }, value_type{});
+            return;
+        }
+
+        auto retry = [this](auto handler)
+        {
+            receive_impl(std::move(handler), true);
+        };
+
+        receivers_.park(new detail::parked_operation<std::decay_t<_Handler>, decltype(retry)>(std::move(handler), std::move(retry)));
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ring_.empty() || is_closed())
+            receivers_.wake_one();
+    }
+
+    // a retried operation already runs on the handler's executor and may complete inline;
+    // completing from within the initiating function must go through post() instead
+    template <typename _Handler, typename... _Args>
+    static void complete(_Handler&& handler, bool resumed, _Args&&... args)
+    {
+        if (resumed)
+        {
+            std::move(handler)(std::forward<_Args>(args)...);
+            return;
+        }
+
+        auto ex = boost::asio::get_associated_executor(handler);
+        boost::asio::post(ex, detail::bind_handler(std::move(handler), [... args = std::forward<_Args>(args)](auto&& h) mutable
+        {
+            std::move(h)(std::move(args)...);
+        }));
+    }
+
+    _Ring<value_type> ring_;
+    alignas(detail::CacheLine) std::atomic<bool> closed_ = false;
+    detail::wait_list receivers_;
+    detail::wait_list senders_;
+};
+
+
+// one sender, one receiver at a time
+template <typename _T>
+using spsc_channel = async_channel<_T, detail::spsc_ring>;
+
+} // namespace channel {}
+
+
+template <typename _Handler, typename _F, typename _Executor>
+struct boost::asio::associated_executor<channel::detail::bound_handler<_Handler, _F>, _Executor>
+{
+    using type = boost::asio::associated_executor_t<_Handler, _Executor>;
+
+    static type get(const channel::detail::bound_handler<_Handler, _F>& b, const _Executor& ex = _Executor()) noexcept
+    {
+        return boost::asio::get_associated_executor(b.handler, ex);
+    }
+};
+
+template <typename _Handler, typename _F, typename _Allocator>
+struct boost::asio::associated_allocator<channel::detail::bound_handler<_Handler, _F>, _Allocator>
+{
+    using type = boost::asio::associated_allocator_t<_Handler, _Allocator>;
+
+    static type get(const channel::detail::bound_handler<_Handler, _F>& b, const _Allocator& a = _Allocator()) noexcept
+    {
+        return boost::asio::get_associated_allocator(b.handler, a);
+    }
+};
+
+template <typename _Handler, typename _F, typename _Slot>
+struct boost::asio::associated_cancellation_slot<channel::detail::bound_handler<_Handler, _F>, _Slot>
+{
+    using type = boost::asio::associated_cancellation_slot_t<_Handler, _Slot>;
+
+    static type get(const channel::detail::bound_handler<_Handler, _F>& b, const _Slot& s = _Slot()) noexcept
+    {
+        return boost::asio::get_associated_cancellation_slot(b.handler, s);
+    }
+};
@@ -0,0 +1,79 @@
+#include "channel.hxx"
+
+#include <thread>
+
+
+namespace
+{
+
+
+generator<int> numbers(int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        co_yield std::move(i);
+    }
+}
+
+boost::asio::awaitable<void> produce(channel::spsc_channel<int>& out)
+{
+    VerboseBlock("produce()");
+
+    co_await out.send_all(numbers(20));
+    out.close();
+}
+
+boost::asio::awaitable<void> square(channel::spsc_channel<int>& in, channel::async_channel<std::string>& out)
+{
+    VerboseBlock("square()");
+
+    while (auto v = co_await in.receive())
+    {
+        co_await out.send(std::format("{}^2 = {}", *v, *v * *v));
+    }
+
+    out.close();
+}
+
+boost::asio::awaitable<void> consume(channel::async_channel<std::string>& in)
+{
+    VerboseBlock("consume()");
+
+    while (auto v = co_await in.receive())
+    {
+        Info("[{}]", *v);
+
+        // whatever arrived while we were waiting, without suspending again
+        auto more = in.drain();
+        while (auto s = more.next())
+        {
+            Info("[{}] (drained)", *s);
+        }
+    }
+}
+
+
+} // namespace {}
+
+
+
+int main()
+{
+    VerboseBlock("main()");
+
+    channel::spsc_channel<int> numbers{ 4 };
+    channel::async_channel<std::string> squares{ 4 };
+
+    // each stage on its own thread
+    boost::asio::io_context a, b, c;
+
+    co_spawn(a, produce(numbers), boost::asio::detached);
+    co_spawn(b, square(numbers, squares), boost::asio::detached);
+    co_spawn(c, consume(squares), boost::asio::detached);
+
+    std::jthread ta{ [&a]() { a.run(); } };
+    std::jthread tb{ [&b]() { b.run(); } };
+    c.run();
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#ifndef CXX_CORO_COMMON_HXX_INCLUDED
+#include "common.hxx"
+#endif
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace cxx_coro
+{
+
+class buffer_pool;
+
+
+// A buffer borrowed from a buffer_pool; goes back to the pool when destroyed.
+// Move-only, so it can be handed from a producer coroutine to a consumer without copying the payload.
+class buffer_lease
+{
+public:
+    ~buffer_lease()
+    {
+        release();
+    }
+
+    buffer_lease() noexcept = default;
+
+    buffer_lease(const buffer_lease&) = delete;
+    buffer_lease& operator=(const buffer_lease&) = delete;
+
+    buffer_lease(buffer_lease&& o) noexcept
+        : pool_(std::exchange(o.pool_, nullptr))
+        , data_(std::move(o.data_))
+    {
+    }
+
+    buffer_lease& operator=(buffer_lease&& o) noexcept
+    {
+        if (this != &o)
+        {
+            release();
+            pool_ = std::exchange(o.pool_, nullptr);
+            data_ = std::move(o.data_);
+        }
+
+        return *this;
+    }
+
+    char* data() noexcept
+    {
+        return data_.data();
+    }
+
+    const char* data() const noexcept
+    {
+        return data_.data();
+    }
+
+    std::size_t size() const noexcept
+    {
+        return data_.size();
+    }
+
+    std::string_view view() const noexcept
+    {
+        return { data_.data(), data_.size() };
+    }
+
+    std::span<char> span() noexcept
+    {
+        return { data_.data(), data_.size() };
+    }
+
+    void release() noexcept;
+
+private:
+    friend class buffer_pool;
+
+    buffer_lease(buffer_pool* pool, std::vector<char>&& data) noexcept
+        : pool_(pool)
+        , data_(std::move(data))
+    {
+    }
+
+    buffer_pool* pool_ = nullptr;
+    std::vector<char> data_;
+};
+
+
+// A free list of byte buffers. Buffers keep their capacity while in the pool,
+// so once the pool is warm acquire() does not allocate. Not thread-safe: use one per connection or per thread.
+class buffer_pool
+{
+public:
+    explicit buffer_pool(std::size_t max_free = 16, std::size_t max_capacity = 64 * 1024)
+        : max_free_(max_free)
+        , max_capacity_(max_capacity)
+    {
+        free_.reserve(max_free_);
+    }
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    buffer_lease acquire(std::size_t size)
+    {
+        std::vector<char> data;
+        if (!free_.empty())
+        {
+            data = std::move(free_.back());
+            free_.pop_back();
+        }
+
+        data.resize(size);
+        return buffer_lease{ this, std::move(data) };
+    }
+
+    std::size_t free_count() const noexcept
+    {
+        return free_.size();
+    }
+
+    // the pool shared by everything running on the calling thread
+    static buffer_pool& this_thread()
+    {
+        static thread_local buffer_pool pool;
+        return pool;
+    }
+
+private:
+    friend class buffer_lease;
+
+    void put(std::vector<char>&& data) noexcept
+    {
+        // oversized buffers are not kept, so one huge message does not pin memory forever
+        if (free_.size() >= max_free_ || data.capacity() > max_capacity_)
+            return;
+
+        free_.push_back(std::move(data)); // never reallocates, see reserve() above
+    }
+
+    std::size_t max_free_;
+    std::size_t max_capacity_;
+    std::vector<std::vector<char>> free_;
+};
+
+
+inline void buffer_lease::release() noexcept
+{
+    if (pool_)
+        std::exchange(pool_, nullptr)->put(std::move(data_));
+
+    data_ = {};
+}
+
+} // namespace cxx_coro {}
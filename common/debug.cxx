@@ -82,6 +82,11 @@ constexpr std::uint32_t MaxIndent = 32;
 } // namespace {}
 
 
+void IndentScope::print(Level level, std::string_view message)
+{
+    g_Tracer(level, g_indent, message);
+}
+
 void IndentScope::indent() noexcept
 {
     if (g_indent < MaxIndent)
@@ -109,6 +114,9 @@ CXX_CORO_EXPORT TraceFn setTracer(TraceFn&& f)
 
 CXX_CORO_EXPORT void writeln(Level level, std::string_view message)
 {
+    if (trace::enabled())
+        trace::record(trace::Phase::Instant, {}, nullptr, message);
+
     g_Tracer(level, g_indent, message);
 }
 
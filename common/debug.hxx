@@ -9,6 +9,8 @@
 #include <functional>
 #include <string>
 
+#include "trace.hxx"
+
 
 namespace cxx_coro
 {
@@ -61,15 +63,25 @@ struct CXX_CORO_EXPORT IndentScope
 
     template <class... Args>
     IndentScope(Level level, std::string_view format, Args&&... args)
+        : IndentScope(std::vformat(format, std::make_format_args(args...)), level, format)
+    {
+    }
+
+private:
+    // the unformatted string names the trace slice, the message goes along as its argument
+    IndentScope(std::string&& message, Level level, std::string_view format)
+        : trace_(format, message)
     {
-        writeln(level, std::vformat(format, std::make_format_args(args...)));
+        print(level, message);
 
         indent();
     }
 
-private:
+    static void print(Level level, std::string_view message);
     void indent() noexcept;
     void unindent() noexcept;
+
+    trace::Scope trace_;
 };
 
 
@@ -90,6 +102,11 @@ CXX_CORO_EXPORT std::string binaryToAscii(std::string_view binary);
 #define  VerboseBlock(format, ...) \
     ::cxx_coro::IndentScope __is(::cxx_coro::Level::Verbose, format, ##__VA_ARGS__)
 
+#elif CXX_CORO_TRACE
+
+#define Verbose(format, ...)                 ((void)0)
+#define VerboseBlock(format, ...)            ::cxx_coro::trace::Scope __is(format)
+
 #else
 
 #define Verbose(format, ...)                 ((void)0)
@@ -110,6 +127,19 @@ CXX_CORO_EXPORT std::string binaryToAscii(std::string_view binary);
 #define  ErrorBlock(format, ...) \
     ::cxx_coro::IndentScope __is(::cxx_coro::Level::Error, format, ##__VA_ARGS__)
 
+#elif CXX_CORO_TRACE // !CXX_CORO_ENABLE_LOG
+
+// no text, but the scopes still show up on the timeline
+
+#define Verbose(format, ...)                 ((void)0)
+#define VerboseBlock(format, ...)            ::cxx_coro::trace::Scope __is(format)
+
+#define Info(format, ...)                    ((void)0)
+#define InfoBlock(format, ...)               ::cxx_coro::trace::Scope __is(format)
+
+#define Error(format, ...)                   ((void)0)
+#define ErrorBlock(format, ...)              ::cxx_coro::trace::Scope __is(format)
+
 #else // !CXX_CORO_ENABLE_LOG
 
 #define Verbose(format, ...)                 ((void)0)
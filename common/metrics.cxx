@@ -0,0 +1,349 @@
+#include "metrics.hxx"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace cxx_coro
+{
+
+namespace metrics
+{
+
+namespace
+{
+
+constexpr std::size_t CacheLine = 64;
+
+enum class Kind
+{
+    Counter,
+    Gauge
+};
+
+struct Descriptor
+{
+    std::string name;
+    Kind kind;
+};
+
+struct HistogramData
+{
+    std::array<std::atomic<std::uint64_t>, HistogramBuckets> buckets = {};
+    std::atomic<std::uint64_t> count = 0;
+    std::atomic<std::uint64_t> sum = 0;
+};
+
+// Each shard is written by its owning thread only, so plain load+store is enough
+// and there are no read-modify-write operations on the hot path.
+struct alignas(CacheLine) Shard
+{
+    std::array<std::atomic<std::uint64_t>, MaxValues> values = {};
+    std::array<HistogramData, MaxHistograms> histograms = {};
+};
+
+
+inline void bump(std::atomic<std::uint64_t>& v, std::uint64_t n) noexcept
+{
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+
+class Registry
+{
+public:
+    std::size_t registerValue(std::string_view name, Kind kind)
+    {
+        std::lock_guard l(lock_);
+
+        for (std::size_t i = 0; i < values_.size(); ++i)
+        {
+            if (values_[i].name == name)
+                return i;
+        }
+
+        if (values_.size() >= MaxValues)
+            throw std::length_error("too many metrics");
+
+        values_.push_back(Descriptor{ std::string(name), kind });
+        return values_.size() - 1;
+    }
+
+    std::size_t registerHistogram(std::string_view name)
+    {
+        std::lock_guard l(lock_);
+
+        for (std::size_t i = 0; i < histograms_.size(); ++i)
+        {
+            if (histograms_[i] == name)
+                return i;
+        }
+
+        if (histograms_.size() >= MaxHistograms)
+            throw std::length_error("too many histograms");
+
+        histograms_.emplace_back(name);
+        return histograms_.size() - 1;
+    }
+
+    Shard* attach()
+    {
+        auto shard = std::make_unique<Shard>();
+        auto p = shard.get();
+
+        std::lock_guard l(lock_);
+        shards_.push_back(std::move(shard));
+
+        return p;
+    }
+
+    Snapshot snapshot()
+    {
+        Snapshot s;
+        s.timestamp = now();
+
+        std::lock_guard l(lock_);
+
+        for (std::size_t i = 0; i < values_.size(); ++i)
+        {
+            std::uint64_t total = 0;
+            for (auto& shard : shards_)
+                total += shard->values[i].load(std::memory_order_relaxed);
+
+            if (values_[i].kind == Kind::Counter)
+                s.counters.emplace_back(values_[i].name, total);
+            else
+                s.gauges.emplace_back(values_[i].name, static_cast<std::int64_t>(total));
+        }
+
+        for (std::size_t i = 0; i < histograms_.size(); ++i)
+        {
+            HistogramSnapshot h;
+            h.name = histograms_[i];
+
+            std::array<std::uint64_t, HistogramBuckets> merged = {};
+            for (auto& shard : shards_)
+            {
+                auto& data = shard->histograms[i];
+
+                h.count += data.count.load(std::memory_order_relaxed);
+                h.sum += data.sum.load(std::memory_order_relaxed);
+
+                for (std::size_t b = 0; b < HistogramBuckets; ++b)
+                    merged[b] += data.buckets[b].load(std::memory_order_relaxed);
+            }
+
+            for (std::size_t b = 0; b < HistogramBuckets; ++b)
+            {
+                if (merged[b])
+                    h.buckets.emplace_back(bucketLowerBound(b), merged[b]);
+            }
+
+            s.histograms.push_back(std::move(h));
+        }
+
+        return s;
+    }
+
+private:
+    std::mutex lock_; // guards registration and shard list only, never taken on update
+    std::vector<Descriptor> values_;
+    std::vector<std::string> histograms_;
+    std::vector<std::unique_ptr<Shard>> shards_; // shards are never freed so late writers stay safe
+};
+
+Registry& registry()
+{
+    static Registry* r = new Registry; // intentionally leaked: threads may outlive static destructors
+    return *r;
+}
+
+thread_local Shard* t_shard = nullptr;
+
+Shard& shard()
+{
+    if (!t_shard) [[unlikely]]
+        t_shard = registry().attach();
+
+    return *t_shard;
+}
+
+
+void writeJsonString(std::ostringstream& ss, std::string_view s)
+{
+    ss << '"';
+    for (auto c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            ss << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            ss << std::format("\\u{:04x}", static_cast<unsigned>(c));
+        }
+        else
+        {
+            ss << c;
+        }
+    }
+    ss << '"';
+}
+
+} // namespace {}
+
+
+Counter::Counter(std::string_view name)
+    : slot_(registry().registerValue(name, Kind::Counter))
+{
+}
+
+void Counter::add(std::uint64_t n) noexcept
+{
+    bump(shard().values[slot_], n);
+}
+
+Gauge::Gauge(std::string_view name)
+    : slot_(registry().registerValue(name, Kind::Gauge))
+{
+}
+
+void Gauge::add(std::int64_t n) noexcept
+{
+    // per-thread values may wrap below zero, the merged sum is still exact
+    bump(shard().values[slot_], static_cast<std::uint64_t>(n));
+}
+
+Histogram::Histogram(std::string_view name)
+    : slot_(registry().registerHistogram(name))
+{
+}
+
+void Histogram::record(std::uint64_t value) noexcept
+{
+    auto& data = shard().histograms[slot_];
+
+    bump(data.buckets[bucketIndex(value)], 1);
+    bump(data.count, 1);
+    bump(data.sum, value);
+}
+
+
+std::uint64_t HistogramSnapshot::percentile(double p) const noexcept
+{
+    if (!count)
+        return 0;
+
+    auto target = static_cast<std::uint64_t>(p * static_cast<double>(count));
+    std::uint64_t seen = 0;
+    for (auto& [lower, n] : buckets)
+    {
+        seen += n;
+        if (seen > target)
+            return lower;
+    }
+
+    return buckets.back().first;
+}
+
+
+CXX_CORO_EXPORT std::size_t bucketIndex(std::uint64_t value) noexcept
+{
+    if (value < SubBuckets)
+        return static_cast<std::size_t>(value);
+
+    auto msb = static_cast<std::size_t>(std::bit_width(value)) - 1;
+    auto shift = msb - SubBucketBits;
+    auto sub = static_cast<std::size_t>((value >> shift) & (SubBuckets - 1));
+
+    return (shift + 1) * SubBuckets + sub;
+}
+
+CXX_CORO_EXPORT std::uint64_t bucketLowerBound(std::size_t index) noexcept
+{
+    if (index < SubBuckets)
+        return index;
+
+    auto shift = index / SubBuckets - 1;
+    auto sub = index % SubBuckets;
+
+    return (SubBuckets + sub) << shift;
+}
+
+CXX_CORO_EXPORT Snapshot snapshot()
+{
+    return registry().snapshot();
+}
+
+CXX_CORO_EXPORT std::string toJson(const Snapshot& s)
+{
+    std::ostringstream ss;
+
+    ss << "{\"timestamp_ns\":" << s.timestamp;
+
+    ss << ",\"counters\":{";
+    bool first = true;
+    for (auto& [name, value] : s.counters)
+    {
+        if (!first)
+            ss << ',';
+        first = false;
+
+        writeJsonString(ss, name);
+        ss << ':' << value;
+    }
+
+    ss << "},\"gauges\":{";
+    first = true;
+    for (auto& [name, value] : s.gauges)
+    {
+        if (!first)
+            ss << ',';
+        first = false;
+
+        writeJsonString(ss, name);
+        ss << ':' << value;
+    }
+
+    ss << "},\"histograms\":{";
+    first = true;
+    for (auto& h : s.histograms)
+    {
+        if (!first)
+            ss << ',';
+        first = false;
+
+        writeJsonString(ss, h.name);
+        ss << ":{\"count\":" << h.count
+           << ",\"sum\":" << h.sum
+           << ",\"p50\":" << h.percentile(0.5)
+           << ",\"p90\":" << h.percentile(0.9)
+           << ",\"p99\":" << h.percentile(0.99)
+           << ",\"buckets\":[";
+
+        bool firstBucket = true;
+        for (auto& [lower, n] : h.buckets)
+        {
+            if (!firstBucket)
+                ss << ',';
+            firstBucket = false;
+
+            ss << '[' << lower << ',' << n << ']';
+        }
+
+        ss << "]}";
+    }
+
+    ss << "}}";
+
+    return ss.str();
+}
+
+} // namespace metrics {}
+
+} // namespace cxx_coro {}
@@ -0,0 +1,140 @@
+#pragma once
+
+#ifndef CXX_CORO_COMMON_HXX_INCLUDED
+#include "common.hxx"
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace cxx_coro
+{
+
+namespace metrics
+{
+
+constexpr std::size_t MaxValues = 64;       // counters + gauges
+constexpr std::size_t MaxHistograms = 16;
+
+// log-linear histogram: values below 2^SubBucketBits get their own bucket,
+// every further power of two is split into 2^SubBucketBits linear sub-buckets
+constexpr std::size_t SubBucketBits = 3;
+constexpr std::size_t SubBuckets = std::size_t(1) << SubBucketBits;
+constexpr std::size_t HistogramBuckets = (64 - SubBucketBits + 1) * SubBuckets;
+
+
+inline std::uint64_t now() noexcept
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+    );
+}
+
+
+// Metrics are cheap to update from any thread: each thread writes to its own cache-line aligned shard,
+// shards are merged only when a snapshot is taken. Metric objects are meant to be static or global.
+class CXX_CORO_EXPORT Counter
+{
+public:
+    explicit Counter(std::string_view name);
+
+    void add(std::uint64_t n = 1) noexcept;
+
+private:
+    std::size_t slot_;
+};
+
+
+class CXX_CORO_EXPORT Gauge
+{
+public:
+    explicit Gauge(std::string_view name);
+
+    void add(std::int64_t n) noexcept;
+
+    void inc() noexcept
+    {
+        add(1);
+    }
+
+    void dec() noexcept
+    {
+        add(-1);
+    }
+
+private:
+    std::size_t slot_;
+};
+
+
+class CXX_CORO_EXPORT Histogram
+{
+public:
+    explicit Histogram(std::string_view name);
+
+    void record(std::uint64_t value) noexcept;
+
+    // records the time elapsed since 'start' (as returned by metrics::now())
+    void recordSince(std::uint64_t start) noexcept
+    {
+        record(now() - start);
+    }
+
+private:
+    std::size_t slot_;
+};
+
+
+struct GaugeScope
+{
+    ~GaugeScope()
+    {
+        gauge_.dec();
+    }
+
+    explicit GaugeScope(Gauge& gauge) noexcept
+        : gauge_(gauge)
+    {
+        gauge_.inc();
+    }
+
+    GaugeScope(const GaugeScope&) = delete;
+    GaugeScope& operator=(const GaugeScope&) = delete;
+
+private:
+    Gauge& gauge_;
+};
+
+
+struct HistogramSnapshot
+{
+    std::string name;
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets; // { lower bound, count }, non-empty only
+
+    std::uint64_t percentile(double p) const noexcept;
+};
+
+struct Snapshot
+{
+    std::uint64_t timestamp = 0; // metrics::now()
+    std::vector<std::pair<std::string, std::uint64_t>> counters;
+    std::vector<std::pair<std::string, std::int64_t>> gauges;
+    std::vector<HistogramSnapshot> histograms;
+};
+
+
+CXX_CORO_EXPORT Snapshot snapshot();
+CXX_CORO_EXPORT std::string toJson(const Snapshot& s);
+
+CXX_CORO_EXPORT std::size_t bucketIndex(std::uint64_t value) noexcept;
+CXX_CORO_EXPORT std::uint64_t bucketLowerBound(std::size_t index) noexcept;
+
+} // namespace metrics {}
+
+} // namespace cxx_coro {}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "common.hxx"
+#include "metrics.hxx"
+
+#include <csignal>
+#include <string_view>
+
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/as_tuple.hpp>
+
+
+namespace cxx_coro
+{
+
+namespace metrics
+{
+
+// Every connection to the admin endpoint receives a single JSON snapshot, then the connection is closed:
+// $ nc localhost 9000
+inline boost::asio::awaitable<void> admin_listener(boost::asio::ip::tcp::endpoint ep)
+{
+    VerboseBlock("admin_listener()");
+
+    auto executor{ co_await boost::asio::this_coro::executor };
+
+    boost::asio::ip::tcp::acceptor acceptor{ executor, ep };
+    boost::asio::steady_timer backoff{ executor };
+
+    for (;;)
+    {
+        auto [e, socket] = co_await acceptor.async_accept(boost::asio::experimental::as_tuple(boost::asio::use_awaitable));
+        if (e == boost::asio::error::operation_aborted)
+            break;
+
+        if (e)
+        {
+            // e.g. EMFILE: the endpoint stays up, try again a bit later
+            Error("admin accept failed: {}", e.message());
+
+            backoff.expires_after(std::chrono::milliseconds{ 100 });
+            co_await backoff.async_wait(boost::asio::experimental::as_tuple(boost::asio::use_awaitable));
+            continue;
+        }
+
+        try
+        {
+            auto json = toJson(snapshot());
+            json.push_back('\n');
+
+            co_await boost::asio::async_write(socket, boost::asio::buffer(json), boost::asio::deferred);
+        }
+        catch (std::exception& e)
+        {
+            Error("Caught [{}]", e.what());
+        }
+    }
+}
+
+// the admin endpoint is bound to the loopback interface only
+void serve_admin(boost::asio::execution::executor auto ex, std::string_view port)
+{
+    VerboseBlock("serve_admin()");
+
+    boost::asio::ip::tcp::resolver resolver{ ex };
+
+    for (auto re : resolver.resolve("localhost", port))
+    {
+        auto ep{ re.endpoint() };
+
+        Info("Metrics available on: {}:{}", ep.address().to_string(), ep.port());
+
+        boost::asio::co_spawn(ex, admin_listener(std::move(ep)), boost::asio::detached);
+    }
+}
+
+#if CXX_CORO_LINUX
+
+inline boost::asio::awaitable<void> dump_on_signal()
+{
+    VerboseBlock("dump_on_signal()");
+
+    boost::asio::signal_set signals{ co_await boost::asio::this_coro::executor, SIGUSR1 };
+
+    for (;;)
+    {
+        co_await signals.async_wait(boost::asio::deferred);
+
+        Info("{}", toJson(snapshot()));
+    }
+}
+
+#endif
+
+} // namespace metrics {}
+
+} // namespace cxx_coro {}
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef CXX_CORO_COMMON_HXX_INCLUDED
+#include "common.hxx"
+#endif
+
+#include <chrono>
+
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/as_tuple.hpp>
+
+
+namespace cxx_coro
+{
+
+// A condition variable for coroutines on one thread (or strand): wait() parks on a timer that
+// never expires, notify() cancels it. A notification with nobody waiting is remembered.
+class notifier
+{
+public:
+    explicit notifier(boost::asio::any_io_executor ex)
+        : timer_(ex, std::chrono::steady_clock::time_point::max())
+    {
+    }
+
+    void notify()
+    {
+        pending_ = true;
+        timer_.cancel();
+    }
+
+    boost::asio::awaitable<void> wait()
+    {
+        if (!pending_)
+        {
+            co_await timer_.async_wait(boost::asio::experimental::as_tuple(boost::asio::use_awaitable));
+            timer_.expires_at(std::chrono::steady_clock::time_point::max());
+        }
+
+        pending_ = false;
+    }
+
+private:
+    boost::asio::steady_timer timer_;
+    bool pending_ = false;
+};
+
+} // namespace cxx_coro {}
@@ -0,0 +1,81 @@
+#include "profiler.hxx"
+
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+
+
+namespace cxx_coro
+{
+
+namespace profile
+{
+
+namespace
+{
+
+struct Registry
+{
+    std::mutex lock;
+    std::deque<CoroStats> types; // deque never moves its elements
+};
+
+Registry& registry()
+{
+    static Registry* r = new Registry; // intentionally leaked: outlives the atexit() dump
+    return *r;
+}
+
+} // namespace {}
+
+
+CXX_CORO_EXPORT CoroStats& registerType(std::string_view name)
+{
+    auto& r = registry();
+
+    std::lock_guard l(r.lock);
+
+    if (r.types.empty())
+        std::atexit(dump);
+
+    auto& stats = r.types.emplace_back();
+    stats.name = name;
+
+    return stats;
+}
+
+CXX_CORO_EXPORT void dump()
+{
+    auto& r = registry();
+
+    std::lock_guard l(r.lock);
+
+    if (r.types.empty())
+        return;
+
+    // not using Info() so the table is printed even if logging is compiled out
+    info("{:<48} {:>10} {:>6} {:>6} {:>7} {:>10} {:>12} {:>12} {:>14}",
+        "coroutine", "frames", "live", "peak", "bytes", "suspends", "avg wait ns", "max wait ns", "running ns");
+
+    for (auto& s : r.types)
+    {
+        auto suspends = s.suspends.load(std::memory_order_relaxed);
+        auto latency = s.resume_latency.load(std::memory_order_relaxed);
+
+        info("{:<48} {:>10} {:>6} {:>6} {:>7} {:>10} {:>12} {:>12} {:>14}",
+            s.name,
+            s.frames.load(std::memory_order_relaxed),
+            s.live.load(std::memory_order_relaxed),
+            s.peak_live.load(std::memory_order_relaxed),
+            s.frame_bytes.load(std::memory_order_relaxed),
+            suspends,
+            suspends ? latency / suspends : 0,
+            s.max_resume_latency.load(std::memory_order_relaxed),
+            s.running.load(std::memory_order_relaxed)
+        );
+    }
+}
+
+} // namespace profile {}
+
+} // namespace cxx_coro {}
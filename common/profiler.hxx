@@ -0,0 +1,285 @@
+#pragma once
+
+#ifndef CXX_CORO_COMMON_HXX_INCLUDED
+#include "common.hxx"
+#endif
+
+#include "trace.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+
+namespace cxx_coro
+{
+
+namespace profile
+{
+
+// per coroutine type counters, aggregated over all frames of that type
+struct CoroStats
+{
+    std::string_view name;
+
+    std::atomic<std::uint64_t> frames = 0;          // frames ever allocated
+    std::atomic<std::int64_t> live = 0;             // frames currently allocated
+    std::atomic<std::int64_t> peak_live = 0;
+    std::atomic<std::uint64_t> frame_bytes = 0;     // largest frame seen
+    std::atomic<std::uint64_t> suspends = 0;
+    std::atomic<std::uint64_t> resume_latency = 0;  // ns, suspend -> resume, summed
+    std::atomic<std::uint64_t> max_resume_latency = 0;
+    std::atomic<std::uint64_t> running = 0;         // ns spent running, summed
+
+    void updateMax(std::atomic<std::uint64_t>& m, std::uint64_t v) noexcept
+    {
+        auto prev = m.load(std::memory_order_relaxed);
+        while (prev < v && !m.compare_exchange_weak(prev, v, std::memory_order_relaxed))
+        {
+        }
+    }
+};
+
+
+CXX_CORO_EXPORT CoroStats& registerType(std::string_view name);
+CXX_CORO_EXPORT void dump(); // also called at exit once any profiled coroutine has run
+
+
+inline std::uint64_t now() noexcept
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+    );
+}
+
+template <typename _T>
+constexpr std::string_view typeName() noexcept
+{
+    std::string_view name = CXX_CORO_FUNCTION;
+
+#if defined __clang__ || defined __GNUC__
+    auto start = name.find("_T = ");
+    if (start == std::string_view::npos)
+        return name;
+
+    start += 5;
+    auto end = name.find_first_of(";]", start);
+#else
+    auto start = name.find("typeName<");
+    if (start == std::string_view::npos)
+        return name;
+
+    start += 9;
+    auto end = name.rfind(">(void)");
+#endif
+
+    return name.substr(start, end - start);
+}
+
+template <typename _Tag>
+CoroStats& statsFor()
+{
+    static CoroStats& stats = registerType(typeName<_Tag>());
+    return stats;
+}
+
+
+// Does nothing; every hook compiles away.
+struct null_policy
+{
+    static constexpr bool enabled = false;
+
+    template <typename _Tag>
+    static void* allocate(std::size_t size)
+    {
+        return ::operator new(size);
+    }
+
+    template <typename _Tag>
+    static void deallocate(void* p, std::size_t size) noexcept
+    {
+        ::operator delete(p, size);
+    }
+
+    template <typename _Tag>
+    struct frame
+    {
+        void started() noexcept {}
+        void suspended() noexcept {}
+        void resumed() noexcept {}
+        void finished() noexcept {}
+    };
+};
+
+
+// Records frame sizes, live frames, suspend->resume latency and running time per coroutine type.
+// While a trace is being recorded, every stretch a frame spends running is also a slice on its thread.
+struct frame_policy
+{
+    static constexpr bool enabled = true;
+
+    template <typename _Tag>
+    static void* allocate(std::size_t size)
+    {
+        auto& stats = statsFor<_Tag>();
+
+        stats.frames.fetch_add(1, std::memory_order_relaxed);
+        stats.updateMax(stats.frame_bytes, size);
+
+        auto live = stats.live.fetch_add(1, std::memory_order_relaxed) + 1;
+        auto peak = stats.peak_live.load(std::memory_order_relaxed);
+        while (peak < live && !stats.peak_live.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+
+        return ::operator new(size);
+    }
+
+    template <typename _Tag>
+    static void deallocate(void* p, std::size_t size) noexcept
+    {
+        statsFor<_Tag>().live.fetch_sub(1, std::memory_order_relaxed);
+
+        ::operator delete(p, size);
+    }
+
+    template <typename _Tag>
+    struct frame
+    {
+        void started() noexcept
+        {
+            mark_ = now();
+            suspended_ = false;
+
+            traceBegin();
+        }
+
+        void suspended() noexcept
+        {
+            traceEnd();
+
+            auto t = now();
+            auto& stats = statsFor<_Tag>();
+
+            if (!suspended_)
+                stats.running.fetch_add(t - mark_, std::memory_order_relaxed);
+
+            stats.suspends.fetch_add(1, std::memory_order_relaxed);
+            mark_ = t;
+            suspended_ = true;
+        }
+
+        void resumed() noexcept
+        {
+            if (!suspended_)
+                return; // the awaitable was ready, there was no suspension
+
+            traceBegin();
+
+            auto t = now();
+            auto& stats = statsFor<_Tag>();
+            auto latency = t - mark_;
+
+            stats.resume_latency.fetch_add(latency, std::memory_order_relaxed);
+            stats.updateMax(stats.max_resume_latency, latency);
+
+            mark_ = t;
+            suspended_ = false;
+        }
+
+        void finished() noexcept
+        {
+            traceEnd();
+
+            if (!suspended_)
+                statsFor<_Tag>().running.fetch_add(now() - mark_, std::memory_order_relaxed);
+
+            suspended_ = true;
+        }
+
+    private:
+        void traceBegin() noexcept
+        {
+            if (trace::enabled())
+            {
+                trace::record(trace::Phase::Begin, statsFor<_Tag>().name, this);
+                traced_ = true;
+            }
+        }
+
+        void traceEnd() noexcept
+        {
+            if (traced_)
+            {
+                trace::record(trace::Phase::End, statsFor<_Tag>().name, this);
+                traced_ = false;
+            }
+        }
+
+        std::uint64_t mark_ = now(); // time of the last state change
+        bool suspended_ = true;      // frames start suspended unless started() says otherwise
+        bool traced_ = false;        // a trace slice is open for the current run
+    };
+};
+
+
+// A base for promise types that hold their policy's frame as profile: reports every suspension of the
+// coroutine to it. A disabled policy gets the empty specialization: with no await_transform() in the
+// promise at all, co_await is left untouched.
+template <typename _Promise, bool _Enabled>
+struct profiled_await_transform
+{
+};
+
+template <typename _Promise>
+struct profiled_await_transform<_Promise, true>
+{
+    template <typename _Awaitable>
+    auto await_transform(_Awaitable&& awaitable)
+    {
+        // lvalue awaiters are referenced, temporaries and operator co_await() results are held by value
+        using result_type = decltype(get_awaiter(std::forward<_Awaitable>(awaitable)));
+        using awaiter_type = std::conditional_t<std::is_lvalue_reference_v<result_type>, result_type, std::remove_cvref_t<result_type>>;
+
+        struct wrapper
+        {
+            _Promise& promise;
+            awaiter_type awaiter;
+
+            bool await_ready() { return awaiter.await_ready(); }
+            auto await_suspend(std::coroutine_handle<> coro) { promise.profile.suspended(); return awaiter.await_suspend(coro); }
+            auto await_resume() { promise.profile.resumed(); return awaiter.await_resume(); }
+        };
+
+        return wrapper{ static_cast<_Promise&>(*this), get_awaiter(std::forward<_Awaitable>(awaitable)) };
+    }
+
+private:
+    // what co_await would turn the awaitable into: member operator co_await(), then a free one found by ADL
+    template <typename _Awaitable>
+    static decltype(auto) get_awaiter(_Awaitable&& awaitable)
+    {
+        if constexpr (requires { std::forward<_Awaitable>(awaitable).operator co_await(); })
+            return std::forward<_Awaitable>(awaitable).operator co_await();
+        else if constexpr (requires { operator co_await(std::forward<_Awaitable>(awaitable)); })
+            return operator co_await(std::forward<_Awaitable>(awaitable));
+        else
+            return std::forward<_Awaitable>(awaitable);
+    }
+};
+
+
+#if CXX_CORO_PROFILE
+using default_policy = frame_policy;
+#else
+using default_policy = null_policy;
+#endif
+
+} // namespace profile {}
+
+} // namespace cxx_coro {}
@@ -0,0 +1,207 @@
+#pragma once
+
+#ifndef CXX_CORO_COMMON_HXX_INCLUDED
+#include "common.hxx"
+#endif
+
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#if CXX_CORO_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#elif CXX_CORO_WINDOWS
+#include <windows.h>
+#endif
+
+
+namespace cxx_coro
+{
+
+// How an I/O thread waits for work. By default io_context::run() sleeps in epoll as soon as the
+// queue is empty, and the next request pays for the wakeup. With a spin interval the thread keeps
+// calling poll() for that long after the last handler ran, and blocks only when nothing arrives in
+// the meantime: lower tail latency for a core that is busy even when the server is idle.
+namespace run_mode
+{
+
+struct options
+{
+    std::chrono::microseconds spin{ 0 };    // 0: plain run()
+    int busy_poll = 0;                      // SO_BUSY_POLL for the server's sockets, microseconds
+    std::vector<int> cpus;                  // I/O thread i is pinned to cpus[i % size]
+};
+
+
+// a whole decimal number of type _T; nullopt for an empty string, trailing characters or overflow
+template <typename _T>
+std::optional<_T> parse_number(std::string_view s)
+{
+    _T value{};
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (s.empty() || ec != std::errc{} || end != s.data() + s.size())
+        return std::nullopt;
+
+    return value;
+}
+
+// consumes "--spin=us", "--busy-poll=us" and "--cpus=0,2,..."; returns false for anything else,
+// including one of these with a malformed value
+inline bool parse_option(std::string_view arg, options& o)
+{
+    auto value = [arg](std::string_view name) -> std::string_view
+    {
+        return arg.substr(name.size());
+    };
+
+    if (arg.starts_with("--spin="))
+    {
+        auto us = parse_number<std::uint32_t>(value("--spin="));
+        if (!us)
+            return false;
+
+        o.spin = std::chrono::microseconds(*us);
+    }
+    else if (arg.starts_with("--busy-poll="))
+    {
+        auto us = parse_number<int>(value("--busy-poll="));
+        if (!us || *us < 0)
+            return false;
+
+        o.busy_poll = *us;
+    }
+    else if (arg.starts_with("--cpus="))
+    {
+        auto list = value("--cpus=");
+        std::vector<int> cpus;
+
+        for (std::size_t pos = 0; pos <= list.size(); )
+        {
+            auto comma = list.find(',', pos);
+            if (comma == std::string_view::npos)
+                comma = list.size();
+
+            auto cpu = parse_number<int>(list.substr(pos, comma - pos));
+            if (!cpu || *cpu < 0)
+                return false;
+
+            cpus.push_back(*cpu);
+            pos = comma + 1;
+        }
+
+        o.cpus = std::move(cpus);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+constexpr std::string_view usage = "[--spin=us] [--busy-poll=us] [--cpus=N[,N...]]";
+
+
+inline bool pin_thread(int cpu)
+{
+#if CXX_CORO_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#elif CXX_CORO_WINDOWS
+    return ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#endif
+}
+
+// Makes a blocking or non-blocking read poll the device queue for up to usec before giving up.
+// Accepted sockets inherit it from the listening one. Busy polling inside epoll itself is
+// controlled by the net.core.busy_poll sysctl.
+template <typename _Socket>
+void set_busy_poll(_Socket& s, int usec)
+{
+#if CXX_CORO_LINUX
+    if (usec <= 0)
+        return;
+
+    if (::setsockopt(s.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0)
+        Error("SO_BUSY_POLL is not available: {}", strerror(errno));
+#endif
+}
+
+
+// Runs the context on the calling thread until it is stopped or out of work.
+inline std::size_t run(boost::asio::io_context& io, const options& o)
+{
+    if (o.spin.count() <= 0)
+        return io.run();
+
+    std::size_t handlers = 0;
+
+    while (!io.stopped())
+    {
+        auto deadline = std::chrono::steady_clock::now() + o.spin;
+
+        do
+        {
+            if (auto n = io.poll())
+            {
+                handlers += n;
+                deadline = std::chrono::steady_clock::now() + o.spin;
+            }
+
+            if (io.stopped())
+                return handlers;
+        }
+        while (std::chrono::steady_clock::now() < deadline);
+
+        handlers += io.run_one();
+    }
+
+    return handlers;
+}
+
+// Runs the context on the calling thread and threads - 1 more, each pinned as configured.
+inline void run(boost::asio::io_context& io, const options& o, std::size_t threads)
+{
+    auto body = [&io, &o](std::size_t index)
+    {
+        if (!o.cpus.empty())
+        {
+            auto cpu = o.cpus[index % o.cpus.size()];
+            if (!pin_thread(cpu))
+                Error("failed to pin I/O thread #{} to CPU {}", index, cpu);
+        }
+
+        run(io, o);
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i)
+        pool.emplace_back(body, i);
+
+    body(0);
+
+    for (auto& t : pool)
+        t.join();
+}
+
+} // namespace run_mode {}
+
+} // namespace cxx_coro {}
@@ -0,0 +1,377 @@
+#include "common.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#if CXX_CORO_WINDOWS
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+
+namespace cxx_coro
+{
+
+namespace trace
+{
+
+namespace
+{
+
+constexpr std::size_t MaxText = 98;
+
+struct Event
+{
+    std::uint64_t ts;
+    const void* id;
+    const char* name;
+    std::uint32_t nameLength;
+    Phase phase;
+    std::uint8_t textLength;
+    char text[MaxText];     // truncated copy of a log message
+};
+
+static_assert(sizeof(Event) == 128);
+
+
+std::uint64_t now() noexcept
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+    );
+}
+
+std::uint32_t currentThreadId() noexcept
+{
+#if CXX_CORO_WINDOWS
+    return static_cast<std::uint32_t>(::GetCurrentThreadId());
+#else
+    return static_cast<std::uint32_t>(::gettid());
+#endif
+}
+
+std::uint32_t currentProcessId() noexcept
+{
+#if CXX_CORO_WINDOWS
+    return static_cast<std::uint32_t>(::GetCurrentProcessId());
+#else
+    return static_cast<std::uint32_t>(::getpid());
+#endif
+}
+
+
+// Written by its owning thread only. A new start() is noticed by the owner on its next event,
+// which then rewinds the buffer itself, so the control thread never touches the events.
+struct Buffer
+{
+    std::uint32_t tid = currentThreadId();
+    std::atomic<std::uint64_t> generation = 0;  // published after the rewind
+    std::atomic<std::size_t> count = 0;         // published after each event
+    std::atomic<std::uint64_t> dropped = 0;
+    std::unique_ptr<Event[]> events;
+    std::size_t capacity = 0;
+};
+
+
+std::atomic<std::uint64_t> g_generation = 0;    // 0: never started
+std::atomic<std::size_t> g_capacity = DefaultCapacity;
+std::atomic<std::uint64_t> g_origin = 0;        // timestamps are written relative to the last start()
+
+
+class Registry
+{
+public:
+    Buffer* attach()
+    {
+        auto buffer = std::make_unique<Buffer>();
+        auto p = buffer.get();
+
+        std::lock_guard l(lock_);
+        buffers_.push_back(std::move(buffer));
+
+        return p;
+    }
+
+    struct Thread
+    {
+        std::uint32_t tid;
+        std::vector<Event> events;
+    };
+
+    std::vector<Thread> collect(std::uint64_t generation, std::uint64_t& dropped)
+    {
+        std::vector<Thread> threads;
+
+        std::lock_guard l(lock_);
+
+        for (auto& b : buffers_)
+        {
+            if (b->generation.load(std::memory_order_acquire) != generation)
+                continue; // nothing recorded by this thread since start()
+
+            auto count = b->count.load(std::memory_order_acquire);
+            if (count)
+                threads.push_back(Thread{ b->tid, std::vector<Event>(b->events.get(), b->events.get() + count) });
+
+            dropped += b->dropped.load(std::memory_order_relaxed);
+        }
+
+        return threads;
+    }
+
+private:
+    std::mutex lock_; // guards the buffer list only, never taken on record()
+    std::vector<std::unique_ptr<Buffer>> buffers_; // never freed so late writers stay safe
+};
+
+Registry& registry()
+{
+    static Registry* r = new Registry; // intentionally leaked: threads may outlive static destructors
+    return *r;
+}
+
+thread_local Buffer* t_buffer = nullptr;
+
+Buffer& buffer()
+{
+    if (!t_buffer) [[unlikely]]
+        t_buffer = registry().attach();
+
+    return *t_buffer;
+}
+
+void rewind(Buffer& b, std::uint64_t generation)
+{
+    auto capacity = g_capacity.load(std::memory_order_relaxed);
+    if (b.capacity != capacity)
+    {
+        b.events = std::make_unique_for_overwrite<Event[]>(capacity);
+        b.capacity = capacity;
+    }
+
+    b.count.store(0, std::memory_order_relaxed);
+    b.dropped.store(0, std::memory_order_relaxed);
+    b.generation.store(generation, std::memory_order_release);
+}
+
+
+void writeJsonString(std::ostringstream& ss, std::string_view s)
+{
+    ss << '"';
+    for (auto c : s)
+    {
+        if (c == '"' || c == '\\')
+            ss << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            ss << ' ';
+        else
+            ss << c;
+    }
+    ss << '"';
+}
+
+std::string_view nameOf(const Event& e) noexcept
+{
+    if (e.phase == Phase::Instant)
+        return { e.text, e.textLength };
+
+    return { e.name, e.nameLength };
+}
+
+// Chrome wants microseconds; three decimals keep the nanoseconds
+void writeTimestamp(std::ostringstream& ss, std::uint64_t ns)
+{
+    ss << (ns / 1000) << '.' << std::format("{:03}", ns % 1000);
+}
+
+
+// Converts one thread's events. Begin/end pairs that nest properly on the thread become complete ("X")
+// slices on its track. A scope in a coroutine may instead end after other scopes it does not contain
+// have started, or on another thread altogether: such pairs become async ("b"/"e") slices keyed by
+// the scope's address, which Perfetto draws on tracks of their own.
+class Converter
+{
+public:
+    Converter(std::ostringstream& ss, std::uint32_t pid, std::uint64_t origin, bool& first)
+        : ss_(ss)
+        , pid_(pid)
+        , origin_(origin)
+        , first_(first)
+    {
+    }
+
+    void convert(std::uint32_t tid, const std::vector<Event>& events)
+    {
+        tid_ = tid;
+        open_.clear();
+
+        for (auto& e : events)
+        {
+            switch (e.phase)
+            {
+            case Phase::Begin:
+                open_.push_back(&e);
+                break;
+
+            case Phase::End:
+                end(e);
+                break;
+
+            case Phase::Instant:
+                header(e, 'i', e.ts);
+                ss_ << ",\"s\":\"t\"}";
+                break;
+            }
+        }
+
+        // still running when the trace was taken, or finished on another thread
+        for (auto b : open_)
+            async(*b, 'b');
+    }
+
+private:
+    void end(const Event& e)
+    {
+        auto it = std::find_if(open_.rbegin(), open_.rend(), [&e](const Event* b) { return b->id == e.id; });
+        if (it == open_.rend())
+        {
+            async(e, 'e'); // began on another thread, or before start()
+            return;
+        }
+
+        // anything opened after the matching begin and still open overlaps it without nesting
+        auto index = static_cast<std::size_t>(std::distance(it, open_.rend())) - 1;
+        for (auto i = index + 1; i < open_.size(); ++i)
+            async(*open_[i], 'b');
+
+        auto& b = *open_[index];
+        open_.resize(index);
+
+        header(b, 'X', b.ts);
+        ss_ << ",\"dur\":";
+        writeTimestamp(ss_, e.ts - b.ts);
+        arguments(b);
+        ss_ << '}';
+    }
+
+    void async(const Event& e, char phase)
+    {
+        header(e, phase, e.ts);
+        ss_ << ",\"cat\":\"scope\",\"id\":\"" << e.id << '"';
+        if (phase == 'b')
+            arguments(e);
+        ss_ << '}';
+    }
+
+    void header(const Event& e, char phase, std::uint64_t ts)
+    {
+        if (!first_)
+            ss_ << ",\n";
+        first_ = false;
+
+        ss_ << "{\"name\":";
+        writeJsonString(ss_, nameOf(e));
+        ss_ << ",\"ph\":\"" << phase << "\",\"pid\":" << pid_ << ",\"tid\":" << tid_ << ",\"ts\":";
+        writeTimestamp(ss_, ts > origin_ ? ts - origin_ : 0);
+    }
+
+    void arguments(const Event& e)
+    {
+        if (!e.textLength)
+            return;
+
+        ss_ << ",\"args\":{\"message\":";
+        writeJsonString(ss_, { e.text, e.textLength });
+        ss_ << '}';
+    }
+
+    std::ostringstream& ss_;
+    std::uint32_t pid_;
+    std::uint64_t origin_;
+    bool& first_;
+    std::uint32_t tid_ = 0;
+    std::vector<const Event*> open_;
+};
+
+} // namespace {}
+
+
+CXX_CORO_EXPORT void record(Phase phase, std::string_view name, const void* id, std::string_view text) noexcept
+{
+    auto& b = buffer();
+
+    auto generation = g_generation.load(std::memory_order_acquire);
+    if (b.generation.load(std::memory_order_relaxed) != generation) [[unlikely]]
+        rewind(b, generation);
+
+    auto n = b.count.load(std::memory_order_relaxed);
+    if (n >= b.capacity)
+    {
+        b.dropped.store(b.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& e = b.events[n];
+    e.ts = now();
+    e.id = id;
+    e.name = name.data();
+    e.nameLength = static_cast<std::uint32_t>(name.size());
+    e.phase = phase;
+    e.textLength = static_cast<std::uint8_t>(std::min(text.size(), MaxText));
+    std::memcpy(e.text, text.data(), e.textLength);
+
+    b.count.store(n + 1, std::memory_order_release);
+}
+
+CXX_CORO_EXPORT void start(std::size_t eventsPerThread)
+{
+    g_capacity.store(std::max<std::size_t>(eventsPerThread, 1), std::memory_order_relaxed);
+    g_origin.store(now(), std::memory_order_relaxed);
+    g_generation.fetch_add(1, std::memory_order_release);
+
+    detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+CXX_CORO_EXPORT void stop() noexcept
+{
+    detail::g_enabled.store(false, std::memory_order_relaxed);
+}
+
+CXX_CORO_EXPORT std::string toJson()
+{
+    std::uint64_t dropped = 0;
+    auto threads = registry().collect(g_generation.load(std::memory_order_acquire), dropped);
+
+    std::ostringstream ss;
+    ss << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":" << dropped << "},\"traceEvents\":[\n";
+
+    bool first = true;
+    Converter converter{ ss, currentProcessId(), g_origin.load(std::memory_order_relaxed), first };
+    for (auto& t : threads)
+        converter.convert(t.tid, t.events);
+
+    ss << "\n]}\n";
+
+    return ss.str();
+}
+
+CXX_CORO_EXPORT bool write(const std::string& path)
+{
+    std::ofstream f{ path, std::ios::binary | std::ios::trunc };
+    if (!f)
+        return false;
+
+    f << toJson();
+    return bool(f);
+}
+
+} // namespace trace {}
+
+} // namespace cxx_coro {}
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef CXX_CORO_COMMON_HXX_INCLUDED
+#include "common.hxx"
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+namespace cxx_coro
+{
+
+// Timeline recording for chrome://tracing and ui.perfetto.dev.
+//
+// While started, IndentScope (and so every *Block macro), profiled coroutine frames and writeln()
+// append fixed-size events with a steady clock timestamp to a buffer owned by the calling thread:
+// no locks, no allocation after the first event on a thread, one relaxed load when stopped.
+// A full buffer drops further events instead of wrapping, so a trace always starts at start().
+//
+// start(), stop() and write() are meant to be called from one control thread, e.g. a signal handler
+// coroutine. write() after stop() sees everything; write() while recording sees a consistent prefix.
+namespace trace
+{
+
+constexpr std::size_t DefaultCapacity = std::size_t(1) << 14; // events per thread, 128 bytes each
+
+enum class Phase : char
+{
+    Begin = 'B',
+    End = 'E',
+    Instant = 'i'
+};
+
+
+namespace detail
+{
+
+inline std::atomic<bool> g_enabled = false;
+
+} // namespace detail {}
+
+
+inline bool enabled() noexcept
+{
+    return detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+// names are not copied: pass string literals or other strings that outlive the trace
+CXX_CORO_EXPORT void record(Phase phase, std::string_view name, const void* id, std::string_view text = {}) noexcept;
+
+CXX_CORO_EXPORT void start(std::size_t eventsPerThread = DefaultCapacity);
+CXX_CORO_EXPORT void stop() noexcept;
+
+CXX_CORO_EXPORT std::string toJson();
+CXX_CORO_EXPORT bool write(const std::string& path);
+
+
+// A begin/end pair around a scope; the end is recorded only if the begin was.
+class Scope
+{
+public:
+    ~Scope()
+    {
+        if (active_)
+            record(Phase::End, name_, this);
+    }
+
+    explicit Scope(std::string_view name, std::string_view text = {}) noexcept
+        : name_(name)
+        , active_(enabled())
+    {
+        if (active_)
+            record(Phase::Begin, name_, this, text);
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    std::string_view name_;
+    bool active_;
+};
+
+} // namespace trace {}
+
+} // namespace cxx_coro {}
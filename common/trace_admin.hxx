@@ -0,0 +1,59 @@
+#pragma once
+
+#include "common.hxx"
+#include "trace.hxx"
+
+#include <csignal>
+#include <format>
+#include <string>
+
+#include <boost/asio.hpp>
+
+#if CXX_CORO_LINUX
+#include <unistd.h>
+#endif
+
+
+namespace cxx_coro
+{
+
+namespace trace
+{
+
+#if CXX_CORO_LINUX
+
+// The first signal starts recording, the next one stops it and writes <prefix>.<pid>.<n>.json,
+// ready for ui.perfetto.dev or chrome://tracing:
+// $ kill -USR2 <pid>; sleep 1; kill -USR2 <pid>
+inline boost::asio::awaitable<void> toggle_on_signal(std::string prefix, std::size_t eventsPerThread = DefaultCapacity)
+{
+    VerboseBlock("toggle_on_signal()");
+
+    boost::asio::signal_set signals{ co_await boost::asio::this_coro::executor, SIGUSR2 };
+
+    for (unsigned n = 0; ; )
+    {
+        co_await signals.async_wait(boost::asio::deferred);
+
+        if (!enabled())
+        {
+            start(eventsPerThread);
+            Info("trace started");
+            continue;
+        }
+
+        stop();
+
+        auto path = std::format("{}.{}.{}.json", prefix, ::getpid(), n++);
+        if (write(path))
+            Info("trace written to {}", path);
+        else
+            Error("failed to write trace to {}", path);
+    }
+}
+
+#endif
+
+} // namespace trace {}
+
+} // namespace cxx_coro {}
@@ -1,27 +1,64 @@
 import socket
 import sys
+import threading
 
-if '-h' in sys.argv or '--help' in sys.argv or len(sys.argv) > 2:
-  print(f'Usage: {sys.argv[0]} [host[:port]]')
+args = [a for a in sys.argv[1:] if a != '--mux']
+mux = '--mux' in sys.argv
+
+if '-h' in sys.argv or '--help' in sys.argv or len(args) > 1:
+  print(f'Usage: {sys.argv[0]} [host[:port]] [--mux]')
   exit()
 
 host = "localhost"
 port = 8000
 
-if len(sys.argv) == 2:
-  host_port = sys.argv[1].split(":")
+if len(args) == 1:
+  host_port = args[0].split(":")
   host = host_port[0]
   if len(host_port) > 1:
     port = int(host_port[1])
 
 s = socket.create_connection((host, port))
 
+
+def recv_exactly(n):
+  data = b''
+  while len(data) < n:
+    chunk = s.recv(n - len(data))
+    if not chunk:
+      raise ConnectionError('connection closed')
+    data += chunk
+  return data
+
+
+# with --mux (echo_server --mux) every frame carries a request id and replies may come back in any order,
+# so they are printed by a thread of their own while the next requests are being sent
+def receive_replies():
+  try:
+    while True:
+      to_read = int.from_bytes(recv_exactly(2), 'big')
+      request_id = int.from_bytes(recv_exactly(4), 'big')
+      print(f'\nRecv #{request_id}: {recv_exactly(to_read).decode()}')
+  except ConnectionError:
+    pass
+
+
+if mux:
+  threading.Thread(target=receive_replies, daemon=True).start()
+
+request_id = 0
+
 while True:
   msg = input("Send: ").encode()
 
+  if mux:
+    s.sendall(len(msg).to_bytes(2, 'big') + request_id.to_bytes(4, 'big') + msg)
+    request_id += 1
+    continue
+
   buf = len(msg).to_bytes(2, 'big') + msg
 
   s.sendall(buf)
 
-  to_read = int.from_bytes(s.recv(2), 'big')
-  print(f'Recv: {s.recv(to_read).decode()}')
+  to_read = int.from_bytes(recv_exactly(2), 'big')
+  print(f'Recv: {recv_exactly(to_read).decode()}')
@@ -1,17 +1,25 @@
 #pragma once
 
+#include "buffer_pool.hxx"
 #include "common.hxx"
+#include "metrics.hxx"
+#include "notifier.hxx"
+#include "run_mode.hxx"
 
 #include <array>
 #include <bit>
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
 #include <string_view>
 #include <utility>
 #include <vector>
 
 #include <boost/asio.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
 
 
 namespace echo_server
@@ -31,10 +39,36 @@ constexpr auto nbeswap(std::integral auto val) noexcept
 } // namespace util {}
 
 
-boost::asio::awaitable<void> client_handler(boost::asio::ip::tcp::socket s)
+// how accepted connections are served
+struct options
+{
+    bool idle = false;              // idle_client_handler(): no buffer is held between messages
+    std::size_t mux = 0;            // mux::client_handler() with up to this many requests in flight; 0: off
+    int busy_poll = 0;              // SO_BUSY_POLL, microseconds
+};
+
+
+namespace stats
+{
+
+inline cxx_coro::metrics::Counter accepted{ "echo_server.accepted" };
+inline cxx_coro::metrics::Gauge connections{ "echo_server.connections" };
+inline cxx_coro::metrics::Counter messages{ "echo_server.messages" };
+inline cxx_coro::metrics::Counter bytes_in{ "echo_server.bytes_in" };
+inline cxx_coro::metrics::Counter bytes_out{ "echo_server.bytes_out" };
+inline cxx_coro::metrics::Histogram handler_latency{ "echo_server.handler_latency_ns" };
+
+} // namespace stats {}
+
+
+// The handlers work on any AsyncReadStream/AsyncWriteStream: TCP and AF_UNIX sockets, or shm::stream.
+template <typename _Stream>
+boost::asio::awaitable<void> client_handler(_Stream s)
 {
     VerboseBlock("client_handler()");
 
+    cxx_coro::metrics::GaugeScope active{ stats::connections };
+
     try
     {
         std::vector<char> data;
@@ -49,39 +83,295 @@ boost::asio::awaitable<void> client_handler(boost::asio::ip::tcp::socket s)
             data.resize(size);
             co_await boost::asio::async_read(s, boost::asio::buffer(data), boost::asio::deferred);
 
+            auto started = cxx_coro::metrics::now();
+            stats::messages.add();
+            stats::bytes_in.add(sizeof(size) + data.size());
+
             Info("received [{}]", cxx_coro::binaryToAscii({ data.data(), size }));
 
             Verbose("sending...");
             size = util::nbeswap(size);
             std::array seq{ boost::asio::buffer(&size, sizeof(size)), boost::asio::buffer(data) };
-            co_await boost::asio::async_write(s, seq, boost::asio::deferred);
+            auto written = co_await boost::asio::async_write(s, seq, boost::asio::deferred);
+
+            stats::bytes_out.add(written);
+            stats::handler_latency.recordSince(started);
+        }
+    }
+    catch (std::exception& e)
+    {
+        Error("Caught [{}]", e.what());
+    }
+}
+
+// Reads and echoes one message with a buffer borrowed from the per-thread pool. Kept out of
+// idle_client_handler() so the header, the buffer and the write sequence live in this short-lived
+// frame rather than in the one that stays allocated while the connection is idle.
+template <typename _Stream>
+boost::asio::awaitable<void> echo_one(_Stream& s)
+{
+    uint16_t size = 0;
+    co_await boost::asio::async_read(s, boost::asio::buffer(&size, sizeof(size)), boost::asio::deferred);
+
+    size = util::nbeswap(size);
+    Verbose("receiving {} bytes...", size);
+
+    auto data = cxx_coro::buffer_pool::this_thread().acquire(size);
+    co_await boost::asio::async_read(s, boost::asio::buffer(data.data(), data.size()), boost::asio::deferred);
+
+    auto started = cxx_coro::metrics::now();
+    stats::messages.add();
+    stats::bytes_in.add(sizeof(size) + data.size());
+
+    Info("received [{}]", cxx_coro::binaryToAscii(data.view()));
+
+    size = util::nbeswap(size);
+    std::array seq{ boost::asio::buffer(&size, sizeof(size)), boost::asio::buffer(data.data(), data.size()) };
+    auto written = co_await boost::asio::async_write(s, seq, boost::asio::deferred);
+
+    stats::bytes_out.add(written);
+    stats::handler_latency.recordSince(started);
+}
+
+// Same protocol as client_handler(), but holds no buffer between messages: it waits for the socket
+// to become readable and only then borrows one from the pool, giving it back once the reply is out.
+template <typename _Socket>
+boost::asio::awaitable<void> idle_client_handler(_Socket s)
+{
+    VerboseBlock("idle_client_handler()");
+
+    cxx_coro::metrics::GaugeScope active{ stats::connections };
+
+    try
+    {
+        for (;;)
+        {
+            co_await s.async_wait(_Socket::wait_read, boost::asio::deferred);
+            co_await echo_one(s);
+        }
+    }
+    catch (std::exception& e)
+    {
+        Error("Caught [{}]", e.what());
+    }
+}
+
+// Multiplexed protocol: every frame carries a request id after its length,
+//   [2-byte big-endian payload length][4-byte request id][payload]
+// and each reply carries the id of its request. Requests on one connection are served concurrently,
+// each by a coroutine of its own, and replies are written as they complete, in whatever order, so
+// a slow request does not hold up the ones behind it. The id is opaque to the server.
+namespace mux
+{
+
+constexpr std::size_t HeaderSize = 2 + 4;
+constexpr std::size_t DefaultLimit = 64;    // requests in flight per connection before we stop reading from it
+
+
+using header = std::array<char, HeaderSize>;
+
+struct reply
+{
+    header head;                            // the request's, length updated
+    std::vector<char> payload;
+    std::uint64_t started;
+};
+
+
+// Shared by the reader, the writer and the requests of one connection, which all run on one strand.
+template <typename _Stream>
+struct connection
+{
+    connection(_Stream s, std::size_t limit)
+        : socket(std::move(s))
+        , limit(limit)
+        , wake(socket.get_executor())
+        , room(socket.get_executor())
+    {
+    }
+
+    _Stream socket;
+    std::size_t limit;
+    std::size_t running = 0;
+    bool done = false;                      // no more requests will be read
+    std::vector<reply> replies;             // completed, not written yet
+    cxx_coro::notifier wake;                // for the writer: a reply is ready or reading is over
+    cxx_coro::notifier room;                // for the reader: a request has completed
+};
+
+
+// the echo server's request handler: the payload is the reply
+boost::asio::awaitable<void> echo(std::vector<char>& payload)
+{
+    Verbose("echoing {} bytes", payload.size());
+    co_return;
+}
+
+template <typename _Stream, typename _Handler>
+boost::asio::awaitable<void> serve(std::shared_ptr<connection<_Stream>> c, header head, std::vector<char> payload, _Handler handler)
+{
+    auto started = cxx_coro::metrics::now();
+
+    try
+    {
+        co_await handler(payload);
+    }
+    catch (std::exception& e)
+    {
+        Error("Caught [{}]", e.what());
+        payload.clear(); // the client still gets an answer for this id
+    }
+
+    if (payload.size() > std::numeric_limits<std::uint16_t>::max())
+    {
+        std::uint32_t id = 0;
+        std::memcpy(&id, head.data() + 2, sizeof(id));
+
+        Error("reply to request #{} is {} bytes, more than a frame holds; answering it empty", util::nbeswap(id), payload.size());
+        payload.clear();
+    }
+
+    auto size = util::nbeswap(static_cast<std::uint16_t>(payload.size()));
+    std::memcpy(head.data(), &size, sizeof(size));
+
+    c->replies.push_back(reply{ head, std::move(payload), started });
+    --c->running;
+
+    c->wake.notify();
+    c->room.notify();
+}
+
+template <typename _Stream, typename _Handler>
+boost::asio::awaitable<void> read_requests(std::shared_ptr<connection<_Stream>> c, _Handler handler)
+{
+    auto executor{ co_await boost::asio::this_coro::executor };
+
+    try
+    {
+        for (;;)
+        {
+            while (c->running >= c->limit)
+                co_await c->room.wait();
+
+            header head;
+            co_await boost::asio::async_read(c->socket, boost::asio::buffer(head), boost::asio::deferred);
+
+            std::uint16_t size = 0;
+            std::memcpy(&size, head.data(), sizeof(size));
+            size = util::nbeswap(size);
+
+            std::vector<char> payload(size);
+            co_await boost::asio::async_read(c->socket, boost::asio::buffer(payload), boost::asio::deferred);
+
+            stats::messages.add();
+            stats::bytes_in.add(head.size() + payload.size());
+
+            ++c->running;
+            boost::asio::co_spawn(executor, serve(c, head, std::move(payload), handler), boost::asio::detached);
         }
     }
     catch (std::exception& e)
     {
         Error("Caught [{}]", e.what());
     }
+
+    c->done = true;
+    c->wake.notify();
 }
 
-boost::asio::awaitable<void> listener(boost::asio::ip::tcp::endpoint ep)
+template <typename _Stream>
+boost::asio::awaitable<void> write_replies(std::shared_ptr<connection<_Stream>> c)
+{
+    std::vector<reply> writing;
+    std::vector<boost::asio::const_buffer> buffers;
+
+    try
+    {
+        for (;;)
+        {
+            if (c->replies.empty())
+            {
+                if (c->done && !c->running)
+                    co_return;
+
+                co_await c->wake.wait();
+                continue;
+            }
+
+            // everything completed since the last write goes out in one gather write
+            writing.swap(c->replies);
+
+            buffers.clear();
+            for (auto& r : writing)
+            {
+                buffers.push_back(boost::asio::buffer(r.head));
+                buffers.push_back(boost::asio::buffer(r.payload));
+            }
+
+            auto written = co_await boost::asio::async_write(c->socket, buffers, boost::asio::deferred);
+            stats::bytes_out.add(written);
+
+            for (auto& r : writing)
+                stats::handler_latency.recordSince(r.started);
+
+            writing.clear();
+        }
+    }
+    catch (std::exception& e)
+    {
+        Error("Caught [{}]", e.what());
+    }
+
+    // unblocks read_requests(); requests still running complete into a connection nobody writes
+    boost::system::error_code ignored;
+    c->socket.close(ignored);
+}
+
+// Run it on a strand when the io_context has several threads.
+template <typename _Stream, typename _Handler>
+boost::asio::awaitable<void> client_handler(_Stream s, std::size_t limit, _Handler handler)
+{
+    VerboseBlock("mux::client_handler()");
+
+    using namespace boost::asio::experimental::awaitable_operators;
+
+    cxx_coro::metrics::GaugeScope active{ stats::connections };
+
+    auto c = std::make_shared<connection<_Stream>>(std::move(s), limit);
+
+    co_await (read_requests(c, handler) && write_replies(c));
+}
+
+} // namespace mux {}
+
+
+template <typename _Protocol>
+boost::asio::awaitable<void> listener(typename _Protocol::endpoint ep, options o)
 {
     VerboseBlock("listener()");
 
     auto executor{ co_await boost::asio::this_coro::executor };
 
-    boost::asio::ip::tcp::acceptor acceptor{ executor, ep };
+    boost::asio::basic_socket_acceptor<_Protocol> acceptor{ executor, ep };
+    cxx_coro::run_mode::set_busy_poll(acceptor, o.busy_poll);
 
     for (;;)
     {
         Verbose("accepting...");
-        boost::asio::ip::tcp::socket socket{ co_await acceptor.async_accept(boost::asio::deferred) };
+        boost::asio::basic_stream_socket<_Protocol> socket{ co_await acceptor.async_accept(boost::asio::deferred) };
 
+        stats::accepted.add();
         Info("new connection started");
-        boost::asio::co_spawn(executor, client_handler(std::move(socket)), boost::asio::detached);
+        if (o.mux)
+            boost::asio::co_spawn(boost::asio::make_strand(executor), mux::client_handler(std::move(socket), o.mux, mux::echo), boost::asio::detached);
+        else if (o.idle)
+            boost::asio::co_spawn(executor, idle_client_handler(std::move(socket)), boost::asio::detached);
+        else
+            boost::asio::co_spawn(executor, client_handler(std::move(socket)), boost::asio::detached);
     }
 }
 
-void accept(boost::asio::execution::executor auto ex, std::string_view host, std::string_view port)
+void accept(boost::asio::execution::executor auto ex, std::string_view host, std::string_view port, const options& o = {})
 {
     VerboseBlock("accept()");
 
@@ -93,10 +383,27 @@ void accept(boost::asio::execution::executor auto ex, std::string_view host, std
 
         Info("Listening on: {}:{}", ep.address().to_string(), ep.port());
 
-        boost::asio::co_spawn(ex, listener(std::move(ep)), boost::asio::detached);
+        boost::asio::co_spawn(ex, listener<boost::asio::ip::tcp>(std::move(ep), o), boost::asio::detached);
     }
 }
 
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+// AF_UNIX stream socket at path; a socket file left behind by a previous run is replaced
+void accept_local(boost::asio::execution::executor auto ex, std::string_view path, const options& o = {})
+{
+    VerboseBlock("accept_local()");
+
+    std::error_code ignored;
+    std::filesystem::remove(path, ignored);
+
+    Info("Listening on: unix:{}", path);
+
+    boost::asio::co_spawn(ex, listener<boost::asio::local::stream_protocol>(boost::asio::local::stream_protocol::endpoint{ path }, o), boost::asio::detached);
+}
+
+#endif
+
 
 
 } // namespace echo_server {}
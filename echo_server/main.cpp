@@ -1,4 +1,12 @@
 #include "echo_server.hxx"
+#include "metrics_admin.hxx"
+#include "shm_transport.hxx"
+#include "trace_admin.hxx"
+#include "udp_echo_server.hxx"
+
+#include <optional>
+#include <string>
+#include <thread>
 
 
 
@@ -14,6 +22,64 @@ std::pair<std::string_view, std::string_view> get_host_port(char* option)
     return { option, "" };
 }
 
+// matches '--name' and '--name=value'
+std::optional<std::string_view> get_option(char* option, std::string_view name)
+{
+    std::string_view o{ option };
+    if (!o.starts_with(name))
+        return std::nullopt;
+
+    o.remove_prefix(name.length());
+    if (o.empty())
+        return o;
+
+    if (o.front() != '=')
+        return std::nullopt;
+
+    return o.substr(1);
+}
+
+// matches '--name=N' with N > 0; a malformed N does not match, so it ends up in usage()
+std::optional<std::size_t> get_count(char* option, std::string_view name)
+{
+    auto v = get_option(option, name);
+    if (!v)
+        return std::nullopt;
+
+    auto n = cxx_coro::run_mode::parse_number<std::size_t>(*v);
+    if (!n || *n == 0)
+        return std::nullopt;
+
+    return n;
+}
+
+// unix:path and shm:path; false if that transport is not available here
+bool serve_local(boost::asio::io_context::executor_type ex, std::string_view local, const echo_server::options& o)
+{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    if (local.starts_with("unix:"))
+    {
+        echo_server::accept_local(ex, local.substr(5), o);
+        return true;
+    }
+#endif
+
+#if CXX_CORO_LINUX
+    if (local.starts_with("shm:"))
+    {
+        echo_server::shm::accept(ex, local.substr(4));
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+void usage(char* self)
+{
+    Info("Usage: {} [host[:port] | unix:path | shm:path] [--admin=port] [--idle] [--mux[=N]] [--udp [--udp-sockets=N] [--udp-simple] [--udp-gro]] {}", self, cxx_coro::run_mode::usage);
+}
+
 
 } // namespace {}
 
@@ -23,16 +89,64 @@ int main(int argc, char** argv)
 {
     VerboseBlock("main()");
 
-    if (argc > 2)
-    {
-        Info("Usage: {} [host[:port]]", argv[0]);
-        std::exit(EXIT_FAILURE);
-    }
+    char* listen_on = nullptr;
+    std::string_view admin_port;
+    bool udp = false;
+    echo_server::options server_options;
+    echo_server::udp::options udp_options;
+    cxx_coro::run_mode::options run_options;
 
-    if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")))
+    for (int i = 1; i < argc; ++i)
     {
-        Info("Usage: {} [host[:port]]", argv[0]);
-        std::exit(EXIT_SUCCESS);
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+        {
+            usage(argv[0]);
+            std::exit(EXIT_SUCCESS);
+        }
+        else if (auto v = get_option(argv[i], "--admin"); v && !v->empty())
+        {
+            admin_port = *v;
+        }
+        else if (auto n = get_count(argv[i], "--udp-sockets"))
+        {
+            udp_options.sockets = *n;
+        }
+        else if (!strcmp(argv[i], "--udp-simple"))
+        {
+            udp_options.batch = false;
+        }
+        else if (!strcmp(argv[i], "--udp-gro"))
+        {
+            udp_options.gro = true;
+        }
+        else if (!strcmp(argv[i], "--idle"))
+        {
+            server_options.idle = true;
+        }
+        else if (!strcmp(argv[i], "--mux"))
+        {
+            server_options.mux = echo_server::mux::DefaultLimit;
+        }
+        else if (auto n = get_count(argv[i], "--mux"))
+        {
+            server_options.mux = *n;
+        }
+        else if (!strcmp(argv[i], "--udp"))
+        {
+            udp = true;
+        }
+        else if (cxx_coro::run_mode::parse_option(argv[i], run_options))
+        {
+        }
+        else if (argv[i][0] != '-' && !listen_on)
+        {
+            listen_on = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+            std::exit(EXIT_FAILURE);
+        }
     }
 
     boost::asio::io_context context;
@@ -46,18 +160,49 @@ int main(int argc, char** argv)
         context.stop();
     });
 
-    if (argc > 1) 
+#if CXX_CORO_LINUX
+    boost::asio::co_spawn(context, cxx_coro::metrics::dump_on_signal(), boost::asio::detached);
+    boost::asio::co_spawn(context, cxx_coro::trace::toggle_on_signal("echo_server"), boost::asio::detached);
+#endif
+
+    if (!admin_port.empty())
+    {
+        cxx_coro::metrics::serve_admin(context.get_executor(), admin_port);
+    }
+
+    std::string_view host{ "localhost" };
+    std::string_view port{ "8000" };
+    std::string_view local;
+    if (listen_on && (!strncmp(listen_on, "unix:", 5) || !strncmp(listen_on, "shm:", 4)))
     {
-        const auto [host, port] = get_host_port(argv[1]);
+        local = listen_on;
+    }
+    else if (listen_on) 
+    {
+        std::tie(host, port) = get_host_port(listen_on);
+    }
 
-        echo_server::accept(context.get_executor(), host, port);
+    if (!local.empty())
+    {
+        if (!serve_local(context.get_executor(), local, server_options))
+        {
+            Error("{} is not supported on this platform", local);
+            return EXIT_FAILURE;
+        }
+    }
+    else if (udp)
+    {
+        udp_options.busy_poll = run_options.busy_poll;
+        echo_server::udp::accept(context.get_executor(), host, port, udp_options);
     }
     else 
     {
-        echo_server::accept(context.get_executor(), "localhost", "8000");
+        server_options.busy_poll = run_options.busy_poll;
+        echo_server::accept(context.get_executor(), host, port, server_options);
     }
 
-    context.run();
+    // each UDP socket is driven by one coroutine, so extra threads let the SO_REUSEPORT sockets run in parallel
+    cxx_coro::run_mode::run(context, run_options, udp ? udp_options.sockets : 1);
      
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,629 @@
+#pragma once
+
+#include "echo_server.hxx"
+
+#if CXX_CORO_LINUX
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include <boost/asio.hpp>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace echo_server
+{
+
+// A transport for clients on the same host: the same length-prefixed frames, carried through two
+// byte rings in a memfd mapping instead of the kernel's socket buffers.
+//
+// A client connects to an AF_UNIX control socket and receives the memfd and four eventfds with
+// SCM_RIGHTS; after that the two sides exchange data through the mapping only. Each ring has one
+// writer and one reader. A side that finds its ring empty (full)
+// raises a flag in the ring header and sleeps on an eventfd, the other side rings that eventfd
+// only when the flag is up, so a busy connection makes no syscalls at all.
+//
+// The control socket stays open and silent for the life of the stream: the kernel closes the peer's
+// end however the peer exits, so the socket turning readable is taken as the peer's close(), and a
+// crashed client does not leave its handler parked on an eventfd forever.
+//
+// shm::stream is an AsyncReadStream/AsyncWriteStream, so client_handler() serves it unchanged.
+namespace shm
+{
+
+constexpr std::size_t RingSize = std::size_t(1) << 18;     // bytes per direction, a power of two
+constexpr std::size_t CacheLine = 64;
+
+
+// Shared between the processes; head is written by the ring's writer only, tail by its reader only.
+struct ring_header
+{
+    alignas(CacheLine) std::atomic<std::uint64_t> head;     // bytes ever written
+    alignas(CacheLine) std::atomic<std::uint64_t> tail;     // bytes ever read
+    alignas(CacheLine) std::atomic<std::uint32_t> reader_waiting;
+    std::atomic<std::uint32_t> writer_waiting;
+    std::atomic<std::uint32_t> writer_closed;
+    std::atomic<std::uint32_t> reader_closed;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the ring indices must work across processes");
+
+
+// [client->server header][server->client header] .. page .. [client->server data][server->client data]
+constexpr std::size_t DataOffset = 4096;
+constexpr std::size_t MappingSize = DataOffset + 2 * RingSize;
+
+static_assert(2 * sizeof(ring_header) <= DataOffset);
+
+
+enum class side
+{
+    client,
+    server
+};
+
+// eventfds, in the order they are passed over the control socket
+enum doorbell
+{
+    to_server_readable,
+    to_server_writable,
+    to_client_readable,
+    to_client_writable,
+    doorbells
+};
+
+
+// This process' view of one ring.
+class ring
+{
+public:
+    ring() noexcept = default;
+
+    ring(void* mapping, std::size_t index) noexcept
+        : header_(static_cast<ring_header*>(mapping) + index)
+        , data_(static_cast<char*>(mapping) + DataOffset + index * RingSize)
+    {
+    }
+
+    ring_header& header() const noexcept
+    {
+        return *header_;
+    }
+
+    template <typename _Buffers>
+    std::size_t read(const _Buffers& buffers) noexcept
+    {
+        auto tail = header_->tail.load(std::memory_order_relaxed);
+        auto available = static_cast<std::size_t>(header_->head.load(std::memory_order_acquire) - tail);
+
+        std::size_t done = 0;
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); available && it != boost::asio::buffer_sequence_end(buffers); ++it)
+        {
+            boost::asio::mutable_buffer b{ *it };
+            auto n = std::min(b.size(), available);
+
+            copy_out(tail + done, static_cast<char*>(b.data()), n);
+            done += n;
+            available -= n;
+        }
+
+        if (done)
+            header_->tail.store(tail + done, std::memory_order_release);
+
+        return done;
+    }
+
+    template <typename _Buffers>
+    std::size_t write(const _Buffers& buffers) noexcept
+    {
+        auto head = header_->head.load(std::memory_order_relaxed);
+        auto room = RingSize - static_cast<std::size_t>(head - header_->tail.load(std::memory_order_acquire));
+
+        std::size_t done = 0;
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); room && it != boost::asio::buffer_sequence_end(buffers); ++it)
+        {
+            boost::asio::const_buffer b{ *it };
+            auto n = std::min(b.size(), room);
+
+            copy_in(head + done, static_cast<const char*>(b.data()), n);
+            done += n;
+            room -= n;
+        }
+
+        if (done)
+            header_->head.store(head + done, std::memory_order_release);
+
+        return done;
+    }
+
+private:
+    void copy_out(std::uint64_t position, char* to, std::size_t n) const noexcept
+    {
+        auto offset = static_cast<std::size_t>(position & (RingSize - 1));
+        auto first = std::min(n, RingSize - offset);
+
+        std::memcpy(to, data_ + offset, first);
+        std::memcpy(to + first, data_, n - first);
+    }
+
+    void copy_in(std::uint64_t position, const char* from, std::size_t n) noexcept
+    {
+        auto offset = static_cast<std::size_t>(position & (RingSize - 1));
+        auto first = std::min(n, RingSize - offset);
+
+        std::memcpy(data_ + offset, from, first);
+        std::memcpy(data_, from + first, n - first);
+    }
+
+    ring_header* header_ = nullptr;
+    char* data_ = nullptr;
+};
+
+
+namespace detail
+{
+
+struct unmap
+{
+    void operator()(void* p) const noexcept
+    {
+        ::munmap(p, MappingSize);
+    }
+};
+
+using mapping = std::unique_ptr<void, unmap>;
+
+
+inline mapping map(int memfd)
+{
+    auto p = ::mmap(nullptr, MappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (p == MAP_FAILED)
+        throw boost::system::system_error(errno, boost::system::system_category(), "mmap");
+
+    return mapping{ p };
+}
+
+inline void ring_bell(int fd) noexcept
+{
+    ::eventfd_write(fd, 1);
+}
+
+// the bells are non-blocking, so this only resets the counter
+inline void silence(int fd) noexcept
+{
+    eventfd_t ignored;
+    ::eventfd_read(fd, &ignored);
+}
+
+struct attempt_result
+{
+    bool done;
+    boost::system::error_code ec;
+    std::size_t transferred;
+};
+
+// Retries attempt() until it completes; in between, raises waiting and sleeps on bell.
+// Waiting is raised before the last attempt, so a peer that makes progress right after
+// that attempt is sure to see the flag and ring.
+//
+// Like a socket's speculative read, a result available straight away is posted rather than
+// delivered from inside the initiating call: a coroutine reading a full ring would otherwise
+// recurse once per operation. The operation itself is posted, holding the result until it runs.
+template <typename _Token, typename _Attempt>
+auto async_park(boost::asio::posix::stream_descriptor& bell, std::atomic<std::uint32_t>& waiting, _Attempt attempt, _Token&& token)
+{
+    return boost::asio::async_compose<_Token, void(boost::system::error_code, std::size_t)>(
+        [&bell, &waiting, attempt = std::move(attempt), armed = false, waited = false, posted = std::optional<attempt_result>{}](auto& self, boost::system::error_code ec = {}) mutable
+        {
+            if (posted)
+            {
+                self.complete(posted->ec, posted->transferred);
+                return;
+            }
+
+            if (ec)
+            {
+                self.complete(ec, 0); // closed: the mapping may be gone already
+                return;
+            }
+
+            if (armed)
+                silence(bell.native_handle());
+
+            for (;;)
+            {
+                auto r = attempt();
+                if (r.done)
+                {
+                    if (armed)
+                        waiting.store(0, std::memory_order_relaxed);
+
+                    if (waited)
+                    {
+                        self.complete(r.ec, r.transferred);
+                        return;
+                    }
+
+                    posted = r;
+
+                    auto ex = bell.get_executor();
+                    boost::asio::post(ex, std::move(self));
+                    return;
+                }
+
+                if (armed)
+                    break;
+
+                waiting.store(1, std::memory_order_seq_cst);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                armed = true;
+            }
+
+            waited = true;
+            bell.async_wait(boost::asio::posix::stream_descriptor::wait_read, std::move(self));
+        },
+        token, bell);
+}
+
+} // namespace detail {}
+
+
+class stream
+{
+public:
+    using executor_type = boost::asio::any_io_executor;
+
+    ~stream()
+    {
+        close();
+    }
+
+    // takes ownership of the control socket, the mapping and the eventfds
+    stream(boost::asio::local::stream_protocol::socket control, detail::mapping m, side s, const std::array<int, doorbells>& fds)
+        : control_(std::move(control))
+        , mapping_(std::move(m))
+        , rx_(mapping_.get(), s == side::server ? 0 : 1)
+        , tx_(mapping_.get(), s == side::server ? 1 : 0)
+        , readable_(control_.get_executor(), fds[s == side::server ? to_server_readable : to_client_readable])
+        , writable_(control_.get_executor(), fds[s == side::server ? to_client_writable : to_server_writable])
+        , peer_readable_(control_.get_executor(), fds[s == side::server ? to_client_readable : to_server_readable])
+        , peer_writable_(control_.get_executor(), fds[s == side::server ? to_server_writable : to_client_writable])
+    {
+        watch_peer();
+    }
+
+    stream(stream&&) noexcept = default;
+    stream& operator=(stream&&) = delete;
+
+    executor_type get_executor() noexcept
+    {
+        return readable_.get_executor();
+    }
+
+    bool is_open() const noexcept
+    {
+        return bool(mapping_);
+    }
+
+    template <typename _Buffers, typename _Token>
+    auto async_read_some(const _Buffers& buffers, _Token&& token)
+    {
+        return detail::async_park(readable_, rx_.header().reader_waiting, [this, buffers]() -> detail::attempt_result
+        {
+            if (boost::asio::buffer_size(buffers) == 0)
+                return { true, {}, 0 };
+
+            auto& h = rx_.header();
+
+            auto n = rx_.read(buffers);
+            if (!n && h.writer_closed.load(std::memory_order_acquire))
+            {
+                n = rx_.read(buffers);  // whatever was written before the close
+                if (!n)
+                    return { true, boost::asio::error::eof, 0 };
+            }
+
+            if (!n)
+                return { false, {}, 0 };
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (h.writer_waiting.load(std::memory_order_relaxed))
+                detail::ring_bell(peer_writable_.native_handle());
+
+            return { true, {}, n };
+        },
+        std::forward<_Token>(token));
+    }
+
+    template <typename _Buffers, typename _Token>
+    auto async_write_some(const _Buffers& buffers, _Token&& token)
+    {
+        return detail::async_park(writable_, tx_.header().writer_waiting, [this, buffers]() -> detail::attempt_result
+        {
+            if (boost::asio::buffer_size(buffers) == 0)
+                return { true, {}, 0 };
+
+            auto& h = tx_.header();
+            if (h.reader_closed.load(std::memory_order_acquire))
+                return { true, boost::asio::error::broken_pipe, 0 };
+
+            auto n = tx_.write(buffers);
+            if (!n)
+                return { false, {}, 0 };
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (h.reader_waiting.load(std::memory_order_relaxed))
+                detail::ring_bell(peer_readable_.native_handle());
+
+            return { true, {}, n };
+        },
+        std::forward<_Token>(token));
+    }
+
+    // the peer reads what is left in its ring, then gets eof; its writes fail with broken_pipe
+    void close() noexcept
+    {
+        if (!mapping_)
+            return;
+
+        tx_.header().writer_closed.store(1, std::memory_order_release);
+        rx_.header().reader_closed.store(1, std::memory_order_release);
+
+        detail::ring_bell(peer_readable_.native_handle());
+        detail::ring_bell(peer_writable_.native_handle());
+
+        boost::system::error_code ignored;
+        control_.close(ignored);
+        readable_.close(ignored);
+        writable_.close(ignored);
+        peer_readable_.close(ignored);
+        peer_writable_.close(ignored);
+
+        mapping_.reset();
+    }
+
+private:
+    // The stream may move while the wait is pending, so the handler holds no pointer to it: the
+    // mapping outlives neither the stream nor its eventfds, and still being mapped means both are there.
+    void watch_peer()
+    {
+        control_.async_wait(boost::asio::local::stream_protocol::socket::wait_read,
+            [mapping = std::weak_ptr<void>(mapping_), rx = &rx_.header(), tx = &tx_.header(),
+             readable = readable_.native_handle(), writable = writable_.native_handle()](boost::system::error_code ec)
+            {
+                auto alive = mapping.lock();
+                if (ec || !alive)
+                    return; // closed on this side
+
+                // the peer is gone, or broke the protocol by writing to the control socket
+                Verbose("shm peer closed its control socket");
+
+                rx->writer_closed.store(1, std::memory_order_release);
+                tx->reader_closed.store(1, std::memory_order_release);
+
+                detail::ring_bell(readable);
+                detail::ring_bell(writable);
+            });
+    }
+
+    boost::asio::local::stream_protocol::socket control_;   // silent; readable once the peer is gone
+    std::shared_ptr<void> mapping_;
+    ring rx_;
+    ring tx_;
+    boost::asio::posix::stream_descriptor readable_;        // we wait on it when rx_ is empty
+    boost::asio::posix::stream_descriptor writable_;        // ... and on this one when tx_ is full
+    boost::asio::posix::stream_descriptor peer_readable_;   // the peer's counterparts, we only ring them
+    boost::asio::posix::stream_descriptor peer_writable_;
+};
+
+
+namespace detail
+{
+
+constexpr std::size_t PassedFds = 1 + doorbells;   // the memfd first
+
+inline boost::asio::awaitable<void> send_fds(boost::asio::local::stream_protocol::socket& s, std::span<const int, PassedFds> fds)
+{
+    char tag = 'S';
+    iovec iov{ &tag, 1 };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * PassedFds)] = {};
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    auto c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int) * PassedFds);
+    std::memcpy(CMSG_DATA(c), fds.data(), sizeof(int) * PassedFds);
+
+    for (;;)
+    {
+        if (::sendmsg(s.native_handle(), &msg, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0)
+            co_return;
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            throw boost::system::system_error(errno, boost::system::system_category(), "sendmsg");
+
+        co_await s.async_wait(boost::asio::local::stream_protocol::socket::wait_write, boost::asio::deferred);
+    }
+}
+
+inline boost::asio::awaitable<std::array<int, PassedFds>> receive_fds(boost::asio::local::stream_protocol::socket& s)
+{
+    char tag = 0;
+    iovec iov{ &tag, 1 };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * PassedFds)] = {};
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    for (;;)
+    {
+        auto n = ::recvmsg(s.native_handle(), &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (n > 0)
+            break;
+
+        if (n == 0)
+            throw boost::system::system_error(boost::asio::error::eof, "recvmsg");
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            throw boost::system::system_error(errno, boost::system::system_category(), "recvmsg");
+
+        co_await s.async_wait(boost::asio::local::stream_protocol::socket::wait_read, boost::asio::deferred);
+    }
+
+    auto c = CMSG_FIRSTHDR(&msg);
+    if (!c || c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS || c->cmsg_len != CMSG_LEN(sizeof(int) * PassedFds))
+        throw boost::system::system_error(boost::asio::error::invalid_argument, "no shared memory offered");
+
+    std::array<int, PassedFds> fds;
+    std::memcpy(fds.data(), CMSG_DATA(c), sizeof(int) * PassedFds);
+
+    co_return fds;
+}
+
+// owns the descriptors until they are handed over to a stream
+struct descriptors
+{
+    ~descriptors()
+    {
+        for (auto fd : fds)
+        {
+            if (fd >= 0)
+                ::close(fd);
+        }
+    }
+
+    std::array<int, doorbells> bells() const noexcept
+    {
+        std::array<int, doorbells> b;
+        std::copy(fds.begin() + 1, fds.end(), b.begin());
+        return b;
+    }
+
+    void release() noexcept
+    {
+        fds.fill(-1);
+    }
+
+    std::array<int, PassedFds> fds = { -1, -1, -1, -1, -1 };
+};
+
+} // namespace detail {}
+
+
+// Server side of the handshake: creates the mapping and the eventfds and passes them to the client.
+inline boost::asio::awaitable<stream> offer(boost::asio::local::stream_protocol::socket control)
+{
+    detail::descriptors d;
+
+    d.fds[0] = ::memfd_create("echo_server.shm", MFD_CLOEXEC);
+    if (d.fds[0] < 0 || ::ftruncate(d.fds[0], MappingSize) < 0)
+        throw boost::system::system_error(errno, boost::system::system_category(), "memfd");
+
+    for (std::size_t i = 1; i < d.fds.size(); ++i)
+    {
+        d.fds[i] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (d.fds[i] < 0)
+            throw boost::system::system_error(errno, boost::system::system_category(), "eventfd");
+    }
+
+    auto m = detail::map(d.fds[0]);
+    for (std::size_t i = 0; i < 2; ++i)
+        new (static_cast<ring_header*>(m.get()) + i) ring_header{};
+
+    co_await detail::send_fds(control, d.fds);
+
+    stream s{ std::move(control), std::move(m), side::server, d.bells() };
+
+    ::close(d.fds[0]);
+    d.release();
+
+    co_return s;
+}
+
+// Client side: connects to the control socket at path and maps what the server offers.
+inline boost::asio::awaitable<stream> connect(std::string_view path)
+{
+    boost::asio::local::stream_protocol::socket control{ co_await boost::asio::this_coro::executor };
+    co_await control.async_connect(boost::asio::local::stream_protocol::endpoint{ path }, boost::asio::deferred);
+
+    detail::descriptors d;
+    d.fds = co_await detail::receive_fds(control);
+
+    auto m = detail::map(d.fds[0]);
+    stream s{ std::move(control), std::move(m), side::client, d.bells() };
+
+    ::close(d.fds[0]);
+    d.release();
+
+    co_return s;
+}
+
+
+inline boost::asio::awaitable<void> listener(boost::asio::local::stream_protocol::endpoint ep)
+{
+    VerboseBlock("shm::listener()");
+
+    auto executor{ co_await boost::asio::this_coro::executor };
+
+    boost::asio::local::stream_protocol::acceptor acceptor{ executor, ep };
+
+    for (;;)
+    {
+        auto control{ co_await acceptor.async_accept(boost::asio::deferred) };
+
+        try
+        {
+            auto s = co_await offer(std::move(control));
+
+            stats::accepted.add();
+            Info("new shared memory connection started");
+
+            boost::asio::co_spawn(executor, client_handler(std::move(s)), boost::asio::detached);
+        }
+        catch (std::exception& e)
+        {
+            Error("Caught [{}]", e.what());
+        }
+    }
+}
+
+// the control socket lives at path; a socket file left behind by a previous run is replaced
+void accept(boost::asio::execution::executor auto ex, std::string_view path)
+{
+    VerboseBlock("shm::accept()");
+
+    std::error_code ignored;
+    std::filesystem::remove(path, ignored);
+
+    Info("Listening on: shm:{}", path);
+
+    boost::asio::co_spawn(ex, listener(boost::asio::local::stream_protocol::endpoint{ path }), boost::asio::detached);
+}
+
+} // namespace shm {}
+
+} // namespace echo_server {}
+
+#endif // CXX_CORO_LINUX
@@ -0,0 +1,379 @@
+#pragma once
+
+#include "common.hxx"
+#include "metrics.hxx"
+#include "run_mode.hxx"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/as_tuple.hpp>
+
+#if CXX_CORO_LINUX
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+
+namespace echo_server
+{
+
+namespace udp
+{
+
+// UDP needs no framing: every datagram is a message and is echoed back as is.
+struct options
+{
+    std::size_t sockets = 1;        // bound with SO_REUSEPORT, the kernel spreads datagrams across them
+    bool batch = true;              // recvmmsg()/sendmmsg() instead of one async_receive_from() per datagram
+    bool gro = false;               // coalesce on receive (UDP_GRO), split again on send (UDP_SEGMENT)
+    int busy_poll = 0;              // SO_BUSY_POLL, microseconds
+};
+
+
+namespace stats
+{
+
+inline cxx_coro::metrics::Counter datagrams{ "echo_server.udp_datagrams" };
+inline cxx_coro::metrics::Counter bytes_in{ "echo_server.udp_bytes_in" };
+inline cxx_coro::metrics::Counter bytes_out{ "echo_server.udp_bytes_out" };
+inline cxx_coro::metrics::Counter truncated{ "echo_server.udp_truncated" };
+inline cxx_coro::metrics::Counter errors{ "echo_server.udp_errors" };
+inline cxx_coro::metrics::Histogram batch_size{ "echo_server.udp_batch_size" };
+
+} // namespace stats {}
+
+
+constexpr std::size_t MaxDatagram = 65536;
+
+
+// A failed receive or send concerns one datagram (an ICMP error such as ECONNREFUSED reported for an
+// earlier reply, EMSGSIZE, ...): it is counted and the socket keeps serving. Only a closed socket ends it.
+inline bool is_fatal(const boost::system::error_code& e)
+{
+    return e == boost::asio::error::operation_aborted || e == boost::asio::error::bad_descriptor || e == boost::asio::error::not_socket;
+}
+
+inline void count_error(std::string_view what, const boost::system::error_code& e)
+{
+    stats::errors.add();
+    Error("{} failed: {}", what, e.message());
+}
+
+
+// one datagram per receive and per send
+boost::asio::awaitable<void> simple_echo(boost::asio::ip::udp::socket s)
+{
+    VerboseBlock("udp::simple_echo()");
+
+    constexpr auto nothrow = boost::asio::experimental::as_tuple(boost::asio::use_awaitable);
+
+    std::vector<char> data(MaxDatagram);
+    boost::asio::ip::udp::endpoint from;
+
+    for (;;)
+    {
+        auto [e1, n] = co_await s.async_receive_from(boost::asio::buffer(data), from, nothrow);
+        if (e1)
+        {
+            if (is_fatal(e1))
+                break;
+
+            count_error("receive", e1);
+            continue;
+        }
+
+        stats::datagrams.add();
+        stats::bytes_in.add(n);
+
+        Verbose("received {} bytes", n);
+
+        auto [e2, sent] = co_await s.async_send_to(boost::asio::buffer(data.data(), n), from, nothrow);
+        if (e2)
+        {
+            if (is_fatal(e2))
+                break;
+
+            count_error("send", e2);
+            continue;
+        }
+
+        stats::bytes_out.add(sent);
+    }
+}
+
+
+#if CXX_CORO_LINUX
+
+// Waits for readability through the reactor, then drains the socket with recvmmsg() and
+// echoes the whole batch with sendmmsg(): two syscalls per batch instead of two per datagram.
+//
+// Every slot holds MaxDatagram bytes, like simple_echo()'s buffer, so no datagram is cut short.
+// The storage is left uninitialized: only the pages datagrams are actually received into become resident.
+class batch
+{
+public:
+    explicit batch(std::size_t count)
+        : data_(std::make_unique_for_overwrite<char[]>(count * MaxDatagram))
+        , names_(count)
+        , controls_(count)
+        , iovs_(count)
+        , msgs_(count)
+    {
+    }
+
+    std::size_t size() const noexcept
+    {
+        return msgs_.size();
+    }
+
+    mmsghdr* messages() noexcept
+    {
+        return msgs_.data();
+    }
+
+    // resets the headers clobbered by the previous recvmmsg()/sendmmsg() and prepare_send()
+    mmsghdr* prepare_receive(bool gro) noexcept
+    {
+        for (std::size_t i = 0; i < msgs_.size(); ++i)
+        {
+            iovs_[i].iov_base = data_.get() + i * MaxDatagram;
+            iovs_[i].iov_len = MaxDatagram;
+
+            auto& h = msgs_[i].msg_hdr;
+            h.msg_iov = &iovs_[i];
+            h.msg_iovlen = 1;
+            h.msg_name = &names_[i];
+            h.msg_namelen = sizeof(sockaddr_storage);
+            h.msg_control = gro ? controls_[i].data() : nullptr;
+            h.msg_controllen = gro ? controls_[i].size() : 0;
+            h.msg_flags = 0;
+        }
+
+        return msgs_.data();
+    }
+
+    struct replies
+    {
+        std::size_t count;      // at the front of messages()
+        std::size_t bytes;
+    };
+
+    // Turns the received datagrams into replies to their senders, in place. A datagram the kernel
+    // had to truncate is counted and dropped rather than echoed cut short.
+    replies prepare_send(std::size_t received, bool gro) noexcept
+    {
+        replies r{ 0, 0 };
+
+        for (std::size_t i = 0; i < received; ++i)
+        {
+            if (msgs_[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                stats::truncated.add();
+                continue;
+            }
+
+            if (r.count != i)
+                msgs_[r.count] = msgs_[i]; // still points at slot i's buffers until the next prepare_receive()
+
+            auto& m = msgs_[r.count++];
+            auto& h = m.msg_hdr;
+
+            h.msg_iov->iov_len = m.msg_len;
+            r.bytes += m.msg_len;
+
+            std::uint16_t segment = 0;
+            if (gro)
+            {
+                for (auto c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(&h, c))
+                {
+                    if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO)
+                    {
+                        int size = 0;
+                        std::memcpy(&size, CMSG_DATA(c), sizeof(size));
+                        segment = static_cast<std::uint16_t>(size);
+                    }
+                }
+            }
+
+            if (segment && segment < m.msg_len)
+            {
+                // several datagrams from one sender were coalesced: let the kernel split the reply the same way
+                h.msg_control = controls_[i].data();
+                h.msg_controllen = CMSG_SPACE(sizeof(segment));
+
+                auto c = CMSG_FIRSTHDR(&h);
+                c->cmsg_level = SOL_UDP;
+                c->cmsg_type = UDP_SEGMENT;
+                c->cmsg_len = CMSG_LEN(sizeof(segment));
+                std::memcpy(CMSG_DATA(c), &segment, sizeof(segment));
+            }
+            else
+            {
+                h.msg_control = nullptr;
+                h.msg_controllen = 0;
+            }
+
+            h.msg_flags = 0;
+        }
+
+        return r;
+    }
+
+private:
+    using control = std::array<char, CMSG_SPACE(sizeof(int))>;
+
+    std::unique_ptr<char[]> data_;
+    std::vector<sockaddr_storage> names_;
+    std::vector<control> controls_;
+    std::vector<iovec> iovs_;
+    std::vector<mmsghdr> msgs_;
+};
+
+
+boost::asio::awaitable<void> batch_echo(boost::asio::ip::udp::socket s, options o)
+{
+    VerboseBlock("udp::batch_echo()");
+
+    try
+    {
+        s.non_blocking(true);
+
+        if (o.gro)
+        {
+            int on = 1;
+            if (::setsockopt(s.native_handle(), SOL_UDP, UDP_GRO, &on, sizeof(on)) < 0)
+            {
+                Error("UDP_GRO is not supported, continuing without it");
+                o.gro = false;
+            }
+        }
+
+        // with GRO one slot may hold a whole coalesced train, so fewer are needed
+        batch b{ o.gro ? 16u : 64u };
+
+        for (;;)
+        {
+            co_await s.async_wait(boost::asio::ip::udp::socket::wait_read, boost::asio::deferred);
+
+            for (;;)
+            {
+                auto received = ::recvmmsg(s.native_handle(), b.prepare_receive(o.gro), static_cast<unsigned>(b.size()), MSG_DONTWAIT, nullptr);
+                if (received < 0)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        break;
+
+                    boost::system::error_code e{ errno, boost::system::system_category() };
+                    if (is_fatal(e))
+                        throw boost::system::system_error(e, "recvmmsg");
+
+                    // the pending error has been consumed; go back to waiting for datagrams
+                    count_error("recvmmsg", e);
+                    break;
+                }
+
+                auto replies = b.prepare_send(static_cast<std::size_t>(received), o.gro);
+
+                stats::datagrams.add(static_cast<std::size_t>(received));
+                stats::bytes_in.add(replies.bytes);
+                stats::batch_size.record(static_cast<std::size_t>(received));
+
+                Verbose("received {} datagrams", received);
+
+                auto count = static_cast<int>(replies.count);
+                int sent = 0;
+                while (sent < count)
+                {
+                    auto n = ::sendmmsg(s.native_handle(), b.messages() + sent, static_cast<unsigned>(count - sent), MSG_DONTWAIT);
+                    if (n < 0)
+                    {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        {
+                            co_await s.async_wait(boost::asio::ip::udp::socket::wait_write, boost::asio::deferred);
+                            continue;
+                        }
+
+                        boost::system::error_code e{ errno, boost::system::system_category() };
+                        if (is_fatal(e))
+                            throw boost::system::system_error(e, "sendmmsg");
+
+                        // sendmmsg() fails only on the first message it could not send: drop that one
+                        count_error("sendmmsg", e);
+                        n = 1;
+                    }
+
+                    sent += n;
+                }
+
+                stats::bytes_out.add(replies.bytes);
+
+                if (static_cast<std::size_t>(received) < b.size())
+                    break; // drained
+            }
+        }
+    }
+    catch (std::exception& e)
+    {
+        Error("Caught [{}]", e.what());
+    }
+}
+
+#endif // CXX_CORO_LINUX
+
+
+void accept(boost::asio::execution::executor auto ex, std::string_view host, std::string_view port, const options& o)
+{
+    VerboseBlock("udp::accept()");
+
+    boost::asio::ip::udp::resolver resolver{ ex };
+
+    for (auto re : resolver.resolve(host, port))
+    {
+        auto ep{ re.endpoint() };
+
+        Info("Listening on: {}:{} (UDP, {} socket(s))", ep.address().to_string(), ep.port(), o.sockets);
+
+        for (std::size_t i = 0; i < o.sockets; ++i)
+        {
+            boost::asio::ip::udp::socket s{ ex };
+            s.open(ep.protocol());
+
+#if CXX_CORO_LINUX
+            using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+            s.set_option(reuse_port(true));
+#endif
+
+            s.bind(ep);
+            cxx_coro::run_mode::set_busy_poll(s, o.busy_poll);
+
+#if CXX_CORO_LINUX
+            if (o.batch)
+            {
+                boost::asio::co_spawn(ex, batch_echo(std::move(s), o), boost::asio::detached);
+                continue;
+            }
+#endif
+
+            boost::asio::co_spawn(ex, simple_echo(std::move(s)), boost::asio::detached);
+        }
+    }
+}
+
+} // namespace udp {}
+
+} // namespace echo_server {}
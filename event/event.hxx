@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.hxx"
+#include "profiler.hxx"
 
 #include <atomic>
 
@@ -121,18 +122,27 @@ inline void async_event::set() noexcept
 
 
 // A simple task-class for void-returning coroutines.
-struct task
+template <typename _Profiler>
+struct basic_task
 {
     struct promise_type
+        : public cxx_coro::profile::profiled_await_transform<promise_type, _Profiler::enabled>
     {
-        task get_return_object() { return {}; }
+        [[no_unique_address]] typename _Profiler::template frame<basic_task> profile;
+
+        static void* operator new(std::size_t size) { return _Profiler::template allocate<basic_task>(size); }
+        static void operator delete(void* p, std::size_t size) noexcept { _Profiler::template deallocate<basic_task>(p, size); }
+
+        basic_task get_return_object() { profile.started(); return {}; }
         std::suspend_never initial_suspend() { return {}; }
-        std::suspend_never final_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { profile.finished(); return {}; }
         void return_void() {}
         void unhandled_exception() {}
     };
 };
 
+using task = basic_task<cxx_coro::profile::default_policy>;
+
 task example(async_event& event)
 {
     co_await event;
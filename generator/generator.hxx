@@ -1,11 +1,12 @@
 #pragma once
 
 #include "common.hxx"
+#include "profiler.hxx"
 
 #include <variant>
 
 
-template <typename _ValueType>
+template <typename _ValueType, typename _Profiler = cxx_coro::profile::default_policy>
 struct generator
 {
     using value_type = _ValueType;
@@ -19,6 +20,17 @@ struct generator
         using handle = std::coroutine_handle<promise_type>;
 
         std::variant<std::monostate, value_type, std::exception_ptr> value;
+        [[no_unique_address]] typename _Profiler::template frame<generator> profile;
+
+        static void* operator new(std::size_t size)
+        {
+            return _Profiler::template allocate<generator>(size);
+        }
+
+        static void operator delete(void* p, std::size_t size) noexcept
+        {
+            _Profiler::template deallocate<generator>(p, size);
+        }
 
         generator get_return_object()
         {
@@ -38,6 +50,7 @@ struct generator
         {
             Verbose("generator::promise_type::final_suspend()");
 
+            profile.finished();
             return {};
         }
 
@@ -53,6 +66,7 @@ struct generator
             Verbose("generator::promise_type::yield_value()");
 
             value.template emplace<Value>(std::move(v));
+            profile.suspended();
             return {};
         }
 
@@ -121,6 +135,13 @@ struct generator
         if (handle_.done())
             return nullptr;
 
+        // the value is only empty before the first resume: that one starts the frame, there was no wait
+        auto& promise = handle_.promise();
+        if (promise.value.index() == promise_type::Empty)
+            promise.profile.started();
+        else
+            promise.profile.resumed();
+
         handle_.resume();
 
         if (auto err = std::get_if<promise_type::Exception>(&handle_.promise().value); err != nullptr)
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "common.hxx"
+#include "profiler.hxx"
 
 #include <boost/asio.hpp>
 
 
-struct interruptible_task
+template <typename _Profiler>
+struct basic_interruptible_task
 {
     struct shared_state
     {
@@ -28,6 +30,17 @@ struct interruptible_task
     struct promise_type
     {
         shared_state::ptr state;
+        [[no_unique_address]] typename _Profiler::template frame<basic_interruptible_task> profile;
+
+        static void* operator new(std::size_t size)
+        {
+            return _Profiler::template allocate<basic_interruptible_task>(size);
+        }
+
+        static void operator delete(void* p, std::size_t size) noexcept
+        {
+            _Profiler::template deallocate<basic_interruptible_task>(p, size);
+        }
 
         promise_type()
             : state{ std::make_shared<shared_state>() }
@@ -42,7 +55,7 @@ struct interruptible_task
             VerboseBlock("{}.interruptible_task::promise_type::promise_type(...)", Ptr(this));
 
             ([this](auto& param) {
-                if constexpr (std::is_same_v<_Args, shared_state::ptr>)
+                if constexpr (std::is_same_v<_Args, typename shared_state::ptr>)
                 {
                     param = state;
                     return true;
@@ -55,7 +68,8 @@ struct interruptible_task
         {
             VerboseBlock("{}.interruptible_task::promise_type::get_return_object()", Ptr(this));
 
-            return interruptible_task{ state };
+            profile.started();
+            return basic_interruptible_task{ state };
         }
 
         std::suspend_never initial_suspend() noexcept
@@ -69,6 +83,7 @@ struct interruptible_task
         {
             Verbose("{}.interruptible_task::promise_type::final_suspend()", Ptr(this));
 
+            profile.finished();
             return {};
         }
 
@@ -89,6 +104,7 @@ struct interruptible_task
 
             struct [[nodiscard]] wrapper
             {
+                promise_type& promise;
                 shared_state::ptr state;
                 _Awaitable awaitable;
 
@@ -113,6 +129,7 @@ struct interruptible_task
                         awaitable.on_terminate(ec);
                     };
 
+                    promise.profile.suspended();
                     return awaitable.await_suspend(coro);
                 }
 
@@ -122,11 +139,12 @@ struct interruptible_task
                 {
                     VerboseBlock("{}.interruptible_task::promise_type::wrapper::await_resume()", Ptr(this));
 
+                    promise.profile.resumed();
                     return awaitable.await_resume();
                 }
             };
 
-            return wrapper{ state, std::forward<_Awaitable>(awaitable) };
+            return wrapper{ *this, state, std::forward<_Awaitable>(awaitable) };
         }
     };
 
@@ -157,21 +175,21 @@ struct interruptible_task
         ptr->on_terminate = nullptr;
     }
 
-    ~interruptible_task()
+    ~basic_interruptible_task()
     {
         Verbose("{}.interruptible_task::~interruptible_task()", Ptr(this));
     }
 
-    interruptible_task(const interruptible_task&) = delete;
-    interruptible_task& operator=(const interruptible_task&) = delete;
+    basic_interruptible_task(const basic_interruptible_task&) = delete;
+    basic_interruptible_task& operator=(const basic_interruptible_task&) = delete;
 
-    interruptible_task(interruptible_task&&) = default;
-    interruptible_task& operator=(interruptible_task&&) = default;
+    basic_interruptible_task(basic_interruptible_task&&) = default;
+    basic_interruptible_task& operator=(basic_interruptible_task&&) = default;
 
 private:
     std::weak_ptr<shared_state> state_;
 
-    interruptible_task(std::weak_ptr<shared_state> state)
+    basic_interruptible_task(std::weak_ptr<shared_state> state)
         : state_(std::move(state))
     {
         Verbose("{}.interruptible_task::interruptible_task()", Ptr(this));
@@ -179,6 +197,64 @@ private:
 };
 
 
+using interruptible_task = basic_interruptible_task<cxx_coro::profile::default_policy>;
+
+
+// An awaitable that sleeps on a _Timer (steady_timer, or virtual_time::virtual_timer) and that
+// interruptible_task::terminate() can cut short.
+template <typename _Timer = boost::asio::steady_timer, typename _Executor, typename _Duration>
+auto interruptible_sleep(_Executor&& executor, _Duration&& duration)
+{
+    VerboseBlock("interruptible_sleep()");
+
+    struct [[nodiscard]] awaitable
+    {
+        _Timer timer;
+        boost::system::error_code error = {};
+
+        bool await_ready()
+        {
+            Verbose("interruptible_sleep::awaitable::await_ready()");
+
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> coro)
+        {
+            VerboseBlock("interruptible_sleep::awaitable::await_suspend()");
+
+            timer.async_wait([this, coro](auto ec) mutable
+            {
+                VerboseBlock("interruptible_sleep::awaitable::timer_callback()");
+
+                if (!error)
+                {
+                    error = ec;
+                }
+
+                coro.resume();
+            });
+        }
+
+        void on_terminate(boost::system::error_code ec)
+        {
+            VerboseBlock("interruptible_sleep::awaitable::on_terminate()");
+
+            error = ec;
+            timer.cancel();
+        }
 
+        void await_resume()
+        {
+            VerboseBlock("interruptible_sleep::awaitable::await_resume()");
 
+            if (error)
+            {
+                Verbose("Rethrowing [{}]", error.message());
+                throw boost::system::system_error(error);
+            }
+        }
+    };
 
+    return awaitable{ _Timer{ std::forward<_Executor>(executor), std::forward<_Duration>(duration) } };
+}
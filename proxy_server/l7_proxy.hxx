@@ -0,0 +1,402 @@
+#pragma once
+
+#include "notifier.hxx"
+#include "proxy_server.hxx"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <vector>
+
+
+namespace proxy_server
+{
+
+// Message-aware mode: client frames (2-byte big-endian length + payload, as in echo_server) are
+// spread one by one across a few persistent backend connections, and the replies are written back
+// to each client in the order its requests arrived.
+//
+// Backends answer in order on each connection, so every backend keeps a FIFO of the requests it
+// has been given and the next reply it reads belongs to the oldest of them. Everything runs on
+// one io_context thread; nothing here is synchronized.
+namespace l7
+{
+
+namespace stats
+{
+
+inline cxx_coro::metrics::Gauge backend_connections{ "proxy_server.backend_connections" };
+inline cxx_coro::metrics::Counter backend_failures{ "proxy_server.backend_failures" };
+inline cxx_coro::metrics::Gauge pending{ "proxy_server.pending_frames" };
+
+} // namespace stats {}
+
+
+constexpr std::size_t MaxPipelined = 64;    // unanswered frames per client before we stop reading from it
+
+
+using frame = std::vector<char>;            // length prefix included, forwarded as is
+
+
+boost::asio::awaitable<std::optional<frame>> read_frame(boost::asio::ip::tcp::socket& s)
+{
+    frame f(2);
+
+    auto [e1, n1] = co_await boost::asio::async_read(s, boost::asio::buffer(f.data(), 2), use_nothrow_awaitable);
+    if (e1)
+        co_return std::nullopt;
+
+    std::size_t size = (std::size_t(std::uint8_t(f[0])) << 8) | std::uint8_t(f[1]);
+    f.resize(2 + size);
+
+    auto [e2, n2] = co_await boost::asio::async_read(s, boost::asio::buffer(f.data() + 2, size), use_nothrow_awaitable);
+    if (e2)
+        co_return std::nullopt;
+
+    co_return f;
+}
+
+
+using cxx_coro::notifier;
+
+
+// One client request on its way through a backend; the client's writer sends it back when ready.
+struct reply
+{
+    explicit reply(std::weak_ptr<notifier> owner) noexcept
+        : owner(std::move(owner))
+    {
+    }
+
+    void complete(frame&& f)
+    {
+        data = std::move(f);
+        ready = true;
+
+        if (auto n = owner.lock())
+            n->notify();
+    }
+
+    void fail()
+    {
+        failed = true;
+        ready = true;
+
+        if (auto n = owner.lock())
+            n->notify();
+    }
+
+    frame data;
+    bool ready = false;
+    bool failed = false;
+    std::weak_ptr<notifier> owner;      // the client may be gone by the time the backend answers
+    std::uint64_t started = cxx_coro::metrics::now();
+};
+
+
+// A persistent connection to one target, reconnected when it breaks.
+class backend
+{
+public:
+    backend(boost::asio::any_io_executor ex, boost::asio::ip::tcp::endpoint target)
+        : socket_(ex)
+        , target_(target)
+        , wake_(ex)
+    {
+    }
+
+    backend(const backend&) = delete;
+    backend& operator=(const backend&) = delete;
+
+    bool connected() const noexcept
+    {
+        return connected_;
+    }
+
+    std::size_t pending() const noexcept
+    {
+        return inflight_.size();
+    }
+
+    void submit(std::shared_ptr<reply> r, frame&& request)
+    {
+        outbox_.push_back(std::move(request));
+        inflight_.push_back(std::move(r));
+        stats::pending.inc();
+
+        wake_.notify();
+    }
+
+    boost::asio::awaitable<void> run()
+    {
+        VerboseBlock("l7::backend::run()");
+
+        boost::asio::steady_timer backoff{ socket_.get_executor() };
+
+        for (;;)
+        {
+            auto [e] = co_await socket_.async_connect(target_, use_nothrow_awaitable);
+            if (!e)
+            {
+                socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+
+                Info("backend {}:{} connected", target_.address().to_string(), target_.port());
+
+                connected_ = true;
+                stats::backend_connections.inc();
+
+                co_await (read_replies() || write_requests());
+
+                stats::backend_connections.dec();
+                connected_ = false;
+
+                Error("backend {}:{} disconnected", target_.address().to_string(), target_.port());
+            }
+
+            stats::backend_failures.add();
+
+            boost::system::error_code ignored;
+            socket_.close(ignored);
+            fail_all();
+
+            backoff.expires_after(1s);
+            co_await backoff.async_wait(use_nothrow_awaitable);
+        }
+    }
+
+private:
+    boost::asio::awaitable<void> write_requests()
+    {
+        std::vector<frame> writing;
+        std::vector<boost::asio::const_buffer> buffers;
+
+        for (;;)
+        {
+            while (outbox_.empty())
+                co_await wake_.wait();
+
+            // everything queued since the last write goes out in one gather write
+            writing.swap(outbox_);
+
+            buffers.clear();
+            for (auto& f : writing)
+                buffers.push_back(boost::asio::buffer(f));
+
+            auto [e, n] = co_await boost::asio::async_write(socket_, buffers, use_nothrow_awaitable);
+            if (e)
+                co_return;
+
+            writing.clear();
+        }
+    }
+
+    boost::asio::awaitable<void> read_replies()
+    {
+        for (;;)
+        {
+            auto f = co_await read_frame(socket_);
+            if (!f)
+                co_return;
+
+            if (inflight_.empty())
+            {
+                Error("unsolicited reply from {}:{}", target_.address().to_string(), target_.port());
+                co_return;
+            }
+
+            auto r = std::move(inflight_.front());
+            inflight_.pop_front();
+            stats::pending.dec();
+
+            r->complete(std::move(*f));
+        }
+    }
+
+    void fail_all()
+    {
+        for (auto& r : inflight_)
+        {
+            r->fail();
+            stats::pending.dec();
+        }
+
+        inflight_.clear();
+        outbox_.clear();
+    }
+
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::ip::tcp::endpoint target_;
+    notifier wake_;
+    bool connected_ = false;
+    std::vector<frame> outbox_;                     // not written yet
+    std::deque<std::shared_ptr<reply>> inflight_;   // written or about to be, in order
+};
+
+
+class backend_pool
+{
+public:
+    backend_pool(boost::asio::any_io_executor ex, const std::vector<boost::asio::ip::tcp::endpoint>& targets, std::size_t per_target)
+    {
+        for (auto& target : targets)
+        {
+            for (std::size_t i = 0; i < per_target; ++i)
+            {
+                auto& b = backends_.emplace_back(std::make_unique<backend>(ex, target));
+                boost::asio::co_spawn(ex, b->run(), boost::asio::detached);
+            }
+        }
+    }
+
+    backend_pool(const backend_pool&) = delete;
+    backend_pool& operator=(const backend_pool&) = delete;
+
+    // the connected backend with the fewest unanswered frames; starting the scan at a rotating
+    // position keeps ties from always landing on the first connection
+    backend* pick() noexcept
+    {
+        backend* best = nullptr;
+
+        auto count = backends_.size();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto& b = backends_[(next_ + i) % count];
+            if (b->connected() && (!best || b->pending() < best->pending()))
+                best = b.get();
+        }
+
+        ++next_;
+        return best;
+    }
+
+private:
+    std::vector<std::unique_ptr<backend>> backends_;
+    std::size_t next_ = 0;
+};
+
+
+boost::asio::awaitable<void> read_requests(boost::asio::ip::tcp::socket& client, backend_pool& pool, std::deque<std::shared_ptr<reply>>& replies, std::shared_ptr<notifier> wake, notifier& room, bool& done)
+{
+    VerboseBlock("l7::read_requests()");
+
+    for (;;)
+    {
+        while (replies.size() >= MaxPipelined && client.is_open())
+            co_await room.wait();
+
+        auto f = co_await read_frame(client);
+        if (!f)
+            break;
+
+        proxy_server::stats::messages.add();
+        proxy_server::stats::bytes_in.add(f->size());
+
+        auto r = std::make_shared<reply>(wake);
+        replies.push_back(r);
+
+        auto b = pool.pick();
+        if (!b)
+        {
+            Error("no backend available");
+            r->fail();
+            break;
+        }
+
+        b->submit(std::move(r), std::move(*f));
+    }
+
+    done = true;
+    wake->notify();
+}
+
+boost::asio::awaitable<void> write_replies(boost::asio::ip::tcp::socket& client, std::deque<std::shared_ptr<reply>>& replies, std::shared_ptr<notifier> wake, notifier& room, bool& done)
+{
+    VerboseBlock("l7::write_replies()");
+
+    std::vector<boost::asio::const_buffer> buffers;
+
+    for (;;)
+    {
+        // replies may arrive out of order from different backends; only a ready prefix can be sent
+        std::size_t count = 0;
+        buffers.clear();
+        while (count < replies.size() && replies[count]->ready && !replies[count]->failed)
+        {
+            buffers.push_back(boost::asio::buffer(replies[count]->data));
+            ++count;
+        }
+
+        if (count)
+        {
+            auto [e, n] = co_await boost::asio::async_write(client, buffers, use_nothrow_awaitable);
+            if (e)
+                break;
+
+            proxy_server::stats::bytes_out.add(n);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                proxy_server::stats::handler_latency.recordSince(replies.front()->started);
+                replies.pop_front();
+            }
+
+            room.notify();
+            continue;
+        }
+
+        if (!replies.empty() && replies.front()->failed)
+            break;      // the client cannot get this reply, and must not get later ones out of order
+
+        if (done && replies.empty())
+            co_return;
+
+        co_await wake->wait();
+    }
+
+    // unblocks read_requests(), whether it is reading or waiting for room
+    boost::system::error_code ignored;
+    client.close(ignored);
+    room.notify();
+}
+
+boost::asio::awaitable<void> session(boost::asio::ip::tcp::socket client, backend_pool& pool)
+{
+    VerboseBlock("l7::session()");
+
+    cxx_coro::metrics::GaugeScope active{ proxy_server::stats::connections };
+
+    auto ex = client.get_executor();
+    auto wake = std::make_shared<notifier>(ex);
+    notifier room{ ex };
+    std::deque<std::shared_ptr<reply>> replies;
+    bool done = false;
+
+    co_await (read_requests(client, pool, replies, wake, room, done) && write_replies(client, replies, wake, room, done));
+}
+
+boost::asio::awaitable<void> listen(boost::asio::ip::tcp::acceptor& acceptor, backend_pool& pool)
+{
+    VerboseBlock("l7::listen()");
+
+    for (;;)
+    {
+        Verbose("accepting connections...");
+
+        auto [e, client] = co_await acceptor.async_accept(use_nothrow_awaitable);
+        if (e)
+            break;
+
+        proxy_server::stats::accepted.add();
+        Info("new connection started");
+
+        client.set_option(boost::asio::ip::tcp::no_delay(true));
+
+        auto ex = client.get_executor();
+        boost::asio::co_spawn(ex, session(std::move(client), pool), boost::asio::detached);
+    }
+}
+
+} // namespace l7 {}
+
+} // namespace proxy_server {}
@@ -1,4 +1,10 @@
 #include "proxy_server.hxx"
+#include "l7_proxy.hxx"
+#include "metrics_admin.hxx"
+#include "run_mode.hxx"
+
+#include <string>
+#include <vector>
 
 
 
@@ -14,6 +20,11 @@ std::pair<std::string_view, std::string_view> get_host_port(char* option)
     return { option, "" };
 }
 
+void usage(char* self)
+{
+    Info("Usage: {} listen_addr:listen_port target_addr:target_port[,target_addr:target_port...] [admin_port] [--l7[=connections_per_target]] [--idle] {}", self, cxx_coro::run_mode::usage);
+}
+
 
 } // namespace {}
 
@@ -25,14 +36,53 @@ int main(int argc, char** argv)
 
     try
     {
-        if (argc != 3)
+        std::vector<char*> positional;
+        std::size_t l7_connections = 0;
+        bool idle = false;
+        cxx_coro::run_mode::options run_options;
+
+        for (int i = 1; i < argc; ++i)
         {
-            Info("Usage: {} listen_addr:listen_port target_addr:target_port", argv[0]);
+            if (!strcmp(argv[i], "--l7"))
+            {
+                l7_connections = 2;
+            }
+            else if (!strncmp(argv[i], "--l7=", 5))
+            {
+                auto n = cxx_coro::run_mode::parse_number<std::size_t>(argv[i] + 5);
+                if (!n || !*n)
+                {
+                    usage(argv[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+
+                l7_connections = *n;
+            }
+            else if (!strcmp(argv[i], "--idle"))
+            {
+                idle = true;
+            }
+            else if (cxx_coro::run_mode::parse_option(argv[i], run_options))
+            {
+            }
+            else if (argv[i][0] != '-')
+            {
+                positional.push_back(argv[i]);
+            }
+            else
+            {
+                usage(argv[0]);
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        if (positional.size() < 2 || positional.size() > 3)
+        {
+            usage(argv[0]);
             std::exit(EXIT_FAILURE);
         }
 
-        const auto [listen_host, listen_port] = get_host_port(argv[1]);
-        const auto [target_host, target_port] = get_host_port(argv[2]);
+        const auto [listen_host, listen_port] = get_host_port(positional[0]);
 
 
         boost::asio::io_context context;
@@ -52,17 +102,50 @@ int main(int argc, char** argv)
             boost::asio::ip::tcp::resolver::passive
         );
 
-        auto target_endpoint =
-            *boost::asio::ip::tcp::resolver(context).resolve(
-            target_host,
-            target_port
-        );
+        // several targets are only useful in L7 mode, where each frame can go to any of them
+        std::vector<boost::asio::ip::tcp::endpoint> targets;
+        for (char* target = strtok(positional[1], ","); target; target = strtok(nullptr, ","))
+        {
+            const auto [target_host, target_port] = get_host_port(target);
+
+            targets.push_back(
+                *boost::asio::ip::tcp::resolver(context).resolve(
+                target_host,
+                target_port
+            ));
+        }
+
+        if (targets.size() > 1 && !l7_connections)
+        {
+            Error("multiple targets need --l7");
+            std::exit(EXIT_FAILURE);
+        }
+
+#if CXX_CORO_LINUX
+        co_spawn(context, cxx_coro::metrics::dump_on_signal(), boost::asio::detached);
+#endif
+
+        if (positional.size() > 2)
+        {
+            cxx_coro::metrics::serve_admin(context.get_executor(), positional[2]);
+        }
 
         boost::asio::ip::tcp::acceptor acceptor(context, listen_endpoint);
+        cxx_coro::run_mode::set_busy_poll(acceptor, run_options.busy_poll);
 
-        co_spawn(context, proxy_server::listen(acceptor, target_endpoint), boost::asio::detached);
+        std::unique_ptr<proxy_server::l7::backend_pool> pool;
+        if (l7_connections)
+        {
+            pool = std::make_unique<proxy_server::l7::backend_pool>(context.get_executor(), targets, l7_connections);
+            co_spawn(context, proxy_server::l7::listen(acceptor, *pool), boost::asio::detached);
+        }
+        else
+        {
+            co_spawn(context, proxy_server::listen(acceptor, targets.front(), idle), boost::asio::detached);
+        }
 
-        context.run();
+        // everything in the proxy runs on this one thread
+        cxx_coro::run_mode::run(context, run_options, 1);
     }
     catch (std::exception& e)
     {
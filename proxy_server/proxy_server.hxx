@@ -1,6 +1,8 @@
 #pragma once
 
+#include "buffer_pool.hxx"
 #include "common.hxx"
+#include "metrics.hxx"
 
 #ifndef NDEBUG
 #define ASIO_ENABLE_HANDLER_TRACKING 1
@@ -19,7 +21,22 @@ using namespace boost::asio::experimental::awaitable_operators;
 constexpr auto use_nothrow_awaitable = boost::asio::experimental::as_tuple(boost::asio::use_awaitable);
 
 
-boost::asio::awaitable<void> transfer(boost::asio::ip::tcp::socket& from, boost::asio::ip::tcp::socket& to, std::chrono::steady_clock::time_point& deadline)
+namespace stats
+{
+
+inline cxx_coro::metrics::Counter accepted{ "proxy_server.accepted" };
+inline cxx_coro::metrics::Gauge connections{ "proxy_server.connections" };
+inline cxx_coro::metrics::Counter messages{ "proxy_server.messages" };
+inline cxx_coro::metrics::Counter bytes_in{ "proxy_server.bytes_in" };
+inline cxx_coro::metrics::Counter bytes_out{ "proxy_server.bytes_out" };
+inline cxx_coro::metrics::Histogram handler_latency{ "proxy_server.handler_latency_ns" };
+
+} // namespace stats {}
+
+
+// The deadlines are on the clock of the timer proxy() watches them with.
+template <typename _Clock>
+boost::asio::awaitable<void> transfer(boost::asio::ip::tcp::socket& from, boost::asio::ip::tcp::socket& to, std::chrono::time_point<_Clock>& deadline)
 {
     VerboseBlock("transfer()");
 
@@ -27,7 +44,7 @@ boost::asio::awaitable<void> transfer(boost::asio::ip::tcp::socket& from, boost:
 
     for (;;)
     {
-        deadline = std::max(deadline, std::chrono::steady_clock::now() + 5s);
+        deadline = std::max(deadline, _Clock::now() + 5s);
 
         Verbose("receiving...");
 
@@ -35,6 +52,10 @@ boost::asio::awaitable<void> transfer(boost::asio::ip::tcp::socket& from, boost:
         if (e1)
             co_return;
 
+        auto started = cxx_coro::metrics::now();
+        stats::messages.add();
+        stats::bytes_in.add(n1);
+
         Info("received [{}]", cxx_coro::binaryToAscii({ data.data(), n1 }));
 
         Verbose("sending...");
@@ -42,43 +63,98 @@ boost::asio::awaitable<void> transfer(boost::asio::ip::tcp::socket& from, boost:
         auto [e2, n2] = co_await boost::asio::async_write(to, boost::asio::buffer(data, n1), use_nothrow_awaitable);
         if (e2)
             co_return;
+
+        stats::bytes_out.add(n2);
+        stats::handler_latency.recordSince(started);
     }
 }
 
-boost::asio::awaitable<void> watchdog(std::chrono::steady_clock::time_point& deadline)
+// transfer() without the buffer in its frame: waits for readability, then borrows one from the per-thread pool
+template <typename _Clock>
+boost::asio::awaitable<void> idle_transfer(boost::asio::ip::tcp::socket& from, boost::asio::ip::tcp::socket& to, std::chrono::time_point<_Clock>& deadline)
+{
+    VerboseBlock("idle_transfer()");
+
+    for (;;)
+    {
+        deadline = std::max(deadline, _Clock::now() + 5s);
+
+        auto [e0] = co_await from.async_wait(boost::asio::ip::tcp::socket::wait_read, use_nothrow_awaitable);
+        if (e0)
+            co_return;
+
+        auto data = cxx_coro::buffer_pool::this_thread().acquire(1024);
+
+        auto [e1, n1] = co_await from.async_read_some(boost::asio::buffer(data.data(), data.size()), use_nothrow_awaitable);
+        if (e1)
+            co_return;
+
+        auto started = cxx_coro::metrics::now();
+        stats::messages.add();
+        stats::bytes_in.add(n1);
+
+        Info("received [{}]", cxx_coro::binaryToAscii({ data.data(), n1 }));
+
+        auto [e2, n2] = co_await boost::asio::async_write(to, boost::asio::buffer(data.data(), n1), use_nothrow_awaitable);
+        if (e2)
+            co_return;
+
+        stats::bytes_out.add(n2);
+        stats::handler_latency.recordSince(started);
+    }
+}
+
+// _Timer may be a virtual_time::virtual_timer to exercise timeouts without waiting for them
+template <typename _Timer = boost::asio::steady_timer>
+boost::asio::awaitable<void> watchdog(typename _Timer::time_point& deadline)
 {
     VerboseBlock("watchdog()");
 
-    boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor);
+    _Timer timer(co_await boost::asio::this_coro::executor);
 
-    auto now = std::chrono::steady_clock::now();
+    auto now = _Timer::clock_type::now();
     while (deadline > now)
     {
         timer.expires_at(deadline);
         co_await timer.async_wait(use_nothrow_awaitable);
-        now = std::chrono::steady_clock::now();
+        now = _Timer::clock_type::now();
     }
 }
 
-boost::asio::awaitable<void> proxy(boost::asio::ip::tcp::socket client, boost::asio::ip::tcp::endpoint target)
+template <typename _Timer = boost::asio::steady_timer>
+boost::asio::awaitable<void> proxy(boost::asio::ip::tcp::socket client, boost::asio::ip::tcp::endpoint target, bool idle)
 {
     VerboseBlock("proxy()");
 
+    cxx_coro::metrics::GaugeScope active{ stats::connections };
+
     boost::asio::ip::tcp::socket server(client.get_executor());
-    std::chrono::steady_clock::time_point client_to_server_deadline{};
-    std::chrono::steady_clock::time_point server_to_client_deadline{};
+    typename _Timer::time_point client_to_server_deadline{};
+    typename _Timer::time_point server_to_client_deadline{};
 
     auto [e] = co_await server.async_connect(target, use_nothrow_awaitable);
-    if (!e)
+    if (!e && idle)
+    {
+        // one deadline and one timer for both directions: the pair ends when neither has moved data for a while;
+        // it is set here because the watchdog may start before either transfer has pushed it out
+        auto& deadline = client_to_server_deadline;
+        deadline = _Timer::clock_type::now() + 5s;
+
+        co_await(
+            (idle_transfer(client, server, deadline) && idle_transfer(server, client, deadline)) ||
+            watchdog<_Timer>(deadline)
+        );
+    }
+    else if (!e)
     {
         co_await(
-            (transfer(client, server, client_to_server_deadline) || watchdog(client_to_server_deadline)) &&
-            (transfer(server, client, server_to_client_deadline) || watchdog(server_to_client_deadline))
+            (transfer(client, server, client_to_server_deadline) || watchdog<_Timer>(client_to_server_deadline)) &&
+            (transfer(server, client, server_to_client_deadline) || watchdog<_Timer>(server_to_client_deadline))
         );
     }
 }
 
-boost::asio::awaitable<void> listen(boost::asio::ip::tcp::acceptor& acceptor, boost::asio::ip::tcp::endpoint target)
+boost::asio::awaitable<void> listen(boost::asio::ip::tcp::acceptor& acceptor, boost::asio::ip::tcp::endpoint target, bool idle = false)
 {
     VerboseBlock("listen()");
 
@@ -90,10 +166,11 @@ boost::asio::awaitable<void> listen(boost::asio::ip::tcp::acceptor& acceptor, bo
         if (e)
             break;
 
+        stats::accepted.add();
         Info("new connection started");
 
         auto ex = client.get_executor();
-        boost::asio::co_spawn(ex, proxy(std::move(client), target), boost::asio::detached);
+        boost::asio::co_spawn(ex, proxy(std::move(client), target, idle), boost::asio::detached);
     }
 }
 
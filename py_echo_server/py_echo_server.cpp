@@ -1,5 +1,6 @@
 
 #include "common.hxx"
+#include "metrics_admin.hxx"
 
 #include <array>
 #include <bit>
@@ -155,10 +156,25 @@ constexpr auto nbeswap(std::integral auto val) noexcept
 } // namespace util {}
 
 
+namespace stats
+{
+
+inline cxx_coro::metrics::Counter accepted{ "py_echo_server.accepted" };
+inline cxx_coro::metrics::Gauge connections{ "py_echo_server.connections" };
+inline cxx_coro::metrics::Counter messages{ "py_echo_server.messages" };
+inline cxx_coro::metrics::Counter bytes_in{ "py_echo_server.bytes_in" };
+inline cxx_coro::metrics::Counter bytes_out{ "py_echo_server.bytes_out" };
+inline cxx_coro::metrics::Histogram handler_latency{ "py_echo_server.handler_latency_ns" };
+
+} // namespace stats {}
+
+
 boost::asio::awaitable<void> client_handler(boost::asio::ip::tcp::socket s, auto& app)
 {
     VerboseBlock("client_handler()");
 
+    cxx_coro::metrics::GaugeScope active{ stats::connections };
+
     PyResult pr{};
 
     try 
@@ -175,6 +191,10 @@ boost::asio::awaitable<void> client_handler(boost::asio::ip::tcp::socket s, auto
             data.resize(sz);
             Verbose("receiving {} bytes...", sz);
             co_await boost::asio::async_read(s, boost::asio::buffer(data), boost::asio::deferred);
+
+            auto started = cxx_coro::metrics::now();
+            stats::messages.add();
+            stats::bytes_in.add(sizeof(hdr) + data.size());
             
             Info("received [{}]", cxx_coro::binaryToAscii({ data.data(), sz }));
 
@@ -187,7 +207,10 @@ boost::asio::awaitable<void> client_handler(boost::asio::ip::tcp::socket s, auto
             hdr = util::nbeswap(static_cast<std::uint16_t>(pr.len));
 
             std::array seq{ boost::asio::buffer(&hdr, sizeof(hdr)), boost::asio::buffer(pr.out, pr.len) };
-            co_await boost::asio::async_write(s, seq, boost::asio::deferred);
+            auto written = co_await boost::asio::async_write(s, seq, boost::asio::deferred);
+
+            stats::bytes_out.add(written);
+            stats::handler_latency.recordSince(started);
         }
     }
     catch (std::exception& e)
@@ -211,6 +234,7 @@ boost::asio::awaitable<void> listener(boost::asio::ip::tcp::endpoint ep, auto& a
         Verbose("accepting...");
         boost::asio::ip::tcp::socket socket{ co_await acceptor.async_accept(boost::asio::deferred) };
 
+        stats::accepted.add();
         Info("new connection started");
         boost::asio::co_spawn(executor, client_handler(std::move(socket), app), boost::asio::detached);
     }
@@ -236,15 +260,16 @@ PyObject* run(PyObject* self, PyObject* const* args, Py_ssize_t nargs, PyObject*
 {
     VerboseBlock("run()");
 
-    static const char* keywords[]{ "app", "host", "port" };
-    static _PyArg_Parser parser{ .format = "O|ss:run", .keywords = keywords };
+    static const char* keywords[]{ "app", "host", "port", "admin_port", nullptr };
+    static _PyArg_Parser parser{ .format = "O|sss:run", .keywords = keywords };
 
     PyObject* appObj;
     const char* host = "localhost";
     const char* port = "8000";
+    const char* admin_port = nullptr;
 
 
-    if (!_PyArg_ParseStackAndKeywords(args, nargs, kwnames, &parser, &appObj, &host, &port))
+    if (!_PyArg_ParseStackAndKeywords(args, nargs, kwnames, &parser, &appObj, &host, &port, &admin_port))
         return nullptr;
 
     Py_IncRef(appObj);
@@ -259,6 +284,13 @@ PyObject* run(PyObject* self, PyObject* const* args, Py_ssize_t nargs, PyObject*
         io.stop();
     });
 
+#if CXX_CORO_LINUX
+    boost::asio::co_spawn(io, cxx_coro::metrics::dump_on_signal(), boost::asio::detached);
+#endif
+
+    if (admin_port)
+        cxx_coro::metrics::serve_admin(io.get_executor(), admin_port);
+
     PythonApp app{ boost::asio::make_strand(io), appObj };
     accept(io.get_executor(), host, port, app);
 
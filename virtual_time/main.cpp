@@ -0,0 +1,150 @@
+#include "virtual_time.hxx"
+
+#include "cancel.hxx"
+#include "interruptible.hxx"
+
+#include <boost/asio/experimental/awaitable_operators.hpp>
+
+using namespace boost::asio::experimental::awaitable_operators;
+using virtual_time::virtual_timer;
+
+
+namespace
+{
+
+double seconds(virtual_time::virtual_clock::time_point t)
+{
+    return std::chrono::duration<double>(t.time_since_epoch()).count();
+}
+
+// interruptible/main.cpp's do_sleep() on virtual time: the first sleep is terminated after 3 s
+template <typename _Executor>
+interruptible_task do_sleep(_Executor executor, interruptible_task::shared_state::ptr state)
+{
+    VerboseBlock("do_sleep()");
+
+    using namespace std::chrono_literals;
+
+    try
+    {
+        Info("[{:.3f} s] Sleeping for 10 s, interrupted after 3 s", seconds(virtual_time::virtual_clock::now()));
+        co_await interruptible_sleep<virtual_timer>(executor, 10s);
+        Info("[{:.3f} s] Continuing...", seconds(virtual_time::virtual_clock::now()));
+    }
+    catch (std::exception& e)
+    {
+        Info("[{:.3f} s] Caught [{}]", seconds(virtual_time::virtual_clock::now()), e.what());
+    }
+
+    Info("[{:.3f} s] Sleeping for 10 s, can not be interrupted", seconds(virtual_time::virtual_clock::now()));
+
+    const std::lock_guard g(*state);
+    co_await interruptible_sleep<virtual_timer>(executor, 10s);
+
+    Info("[{:.3f} s] All done", seconds(virtual_time::virtual_clock::now()));
+}
+
+boost::asio::awaitable<void> terminate_after(interruptible_task& job, std::chrono::seconds delay)
+{
+    virtual_timer timer{ co_await boost::asio::this_coro::executor, delay };
+    co_await timer.async_wait(boost::asio::deferred);
+
+    job.terminate();
+}
+
+// n coroutines each sleeping a pseudo-random number of milliseconds, rounds times
+boost::asio::awaitable<void> sleeper(std::uint32_t seed, std::size_t rounds)
+{
+    virtual_timer timer{ co_await boost::asio::this_coro::executor };
+
+    for (std::size_t i = 0; i < rounds; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        timer.expires_after(std::chrono::milliseconds(1 + seed % 10'000));
+        co_await timer.async_wait(boost::asio::deferred);
+    }
+}
+
+} // namespace {}
+
+
+
+int main(int argc, char** argv)
+{
+    VerboseBlock("main()");
+
+    std::size_t timers = 100'000;
+    std::size_t rounds = 10;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view a{ argv[i] };
+
+        if (a.starts_with("--timers="))
+        {
+            timers = std::stoul(std::string(a.substr(9)));
+        }
+        else if (a.starts_with("--rounds="))
+        {
+            rounds = std::stoul(std::string(a.substr(9)));
+        }
+        else
+        {
+            std::cout << std::format("Usage: {} [--timers=N] [--rounds=N]\n", argv[0]);
+            return a == "-h" || a == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    // virtual_clock is one per process, so each section below starts at the virtual time where the
+    // previous one stopped; the timestamps printed keep counting across them
+    {
+        // cancel/main.cpp, five seconds of periodic work
+        boost::asio::io_context io;
+
+        virtual_timer timer{ io, virtual_timer::time_point::max() };
+
+        co_spawn(
+            io,
+            cancellable::periodic_work<virtual_timer>() ||
+            cancellable::cancel(timer),
+            [](auto, auto)
+            {
+                Info("[{:.3f} s] Stopped", seconds(virtual_time::virtual_clock::now()));
+            }
+        );
+
+        co_spawn(io, cancellable::run_for(timer, std::chrono::seconds(5)), boost::asio::detached);
+
+        virtual_time::run(io);
+    }
+
+    {
+        boost::asio::io_context io;
+
+        auto job = do_sleep(io.get_executor(), std::make_shared<interruptible_task::shared_state>());
+        co_spawn(io, terminate_after(job, std::chrono::seconds(3)), boost::asio::detached);
+
+        virtual_time::run(io);
+    }
+
+    {
+        boost::asio::io_context io;
+
+        for (std::size_t i = 0; i < timers; ++i)
+            co_spawn(io, sleeper(std::uint32_t(i), rounds), boost::asio::detached);
+
+        auto started = virtual_time::virtual_clock::now();
+        auto wall = std::chrono::steady_clock::now();
+
+        virtual_time::run(io);
+
+        Info("{} timers x {} rounds: {:.3f} s of virtual time in {:.3f} s",
+            timers,
+            rounds,
+            seconds(virtual_time::virtual_clock::now()) - seconds(started),
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count()
+        );
+    }
+
+    return 0;
+}
@@ -0,0 +1,435 @@
+#pragma once
+
+#include "common.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <type_traits>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+
+// Virtual time for code written against asio timers. virtual_timer behaves like steady_timer, but its
+// clock only moves when virtual_time::run() finds every coroutine suspended: then it jumps straight to
+// the earliest pending deadline and completes the timers due at it. A ten second sleep costs as much
+// as a post(), and the order in which timers fire depends only on the program, not on the machine.
+namespace virtual_time
+{
+
+class virtual_clock
+{
+public:
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<virtual_clock>;
+
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept
+    {
+        return time_point{ duration{ now_.load(std::memory_order_relaxed) } };
+    }
+
+    // moves the clock forward to t; it never goes back
+    static void advance_to(time_point t) noexcept
+    {
+        auto ns = t.time_since_epoch().count();
+        auto current = now_.load(std::memory_order_relaxed);
+
+        while (current < ns && !now_.compare_exchange_weak(current, ns, std::memory_order_relaxed))
+        {
+        }
+    }
+
+private:
+    // one timeline per process, starting at the epoch
+    static inline std::atomic<rep> now_{ 0 };
+};
+
+
+namespace detail
+{
+
+// type-erased wait handler
+struct wait_op
+{
+    void (*invoke)(wait_op* op, boost::system::error_code ec, bool destroy) = nullptr;
+
+    void complete(boost::system::error_code ec)
+    {
+        invoke(this, ec, false);
+    }
+
+    void destroy()
+    {
+        invoke(this, {}, true);
+    }
+};
+
+// what a timer shares with the queue: the heap may still hold entries for a timer that was
+// re-armed or destroyed, and the generation tells them apart
+struct timer_state
+{
+    virtual_clock::time_point expiry{};
+    std::uint64_t generation = 0;
+    bool queued = false;
+    std::vector<wait_op*> waiters;
+};
+
+} // namespace detail {}
+
+
+// The timer queue of one execution context. Single-threaded: the context is expected to be driven
+// by run() below on one thread.
+class virtual_time_service
+    : public boost::asio::execution_context::service
+{
+public:
+    static inline boost::asio::execution_context::id id;
+
+    explicit virtual_time_service(boost::asio::execution_context& context)
+        : boost::asio::execution_context::service(context)
+    {
+    }
+
+    template <typename _Handler, typename _Executor>
+    void async_wait(const std::shared_ptr<detail::timer_state>& state, const _Executor& ex, _Handler&& handler)
+    {
+        using op_type = wait_op_impl<std::decay_t<_Handler>, _Executor>;
+
+        auto op = new op_type(std::forward<_Handler>(handler), ex);
+
+        if (op->slot.is_connected())
+        {
+            op->slot.assign([this, state = state.get(), op](boost::asio::cancellation_type type)
+            {
+                if (type != boost::asio::cancellation_type::none)
+                    cancel_one(*state, op);
+            });
+        }
+
+        state->waiters.push_back(op);
+
+        if (!state->queued)
+        {
+            state->queued = true;
+            queue_.push({ state->expiry, sequence_++, state->generation, state });
+        }
+    }
+
+    // completes every wait on the timer with operation_aborted and forgets its heap entry
+    std::size_t cancel(detail::timer_state& state)
+    {
+        ++state.generation;
+        state.queued = false;
+
+        auto waiters = std::move(state.waiters);
+        state.waiters.clear();
+
+        for (auto op : waiters)
+            op->complete(boost::asio::error::operation_aborted);
+
+        return waiters.size();
+    }
+
+    // Moves the clock to the earliest deadline somebody still waits for and completes all timers
+    // due at it. Returns false when no timer is pending or the earliest one is armed for
+    // time_point::max(), which means never: jumping there would fire it and leave the clock at its end.
+    bool advance()
+    {
+        if (!discard_stale() || queue_.top().expiry == virtual_clock::time_point::max())
+            return false;
+
+        virtual_clock::advance_to(queue_.top().expiry);
+        complete_due();
+
+        return true;
+    }
+
+    // Completes the timers whose expiry is not after now() without moving the clock: those armed
+    // for a time already reached, or passed by another context's advance(). Returns how many fired.
+    std::size_t complete_due()
+    {
+        auto now = virtual_clock::now();
+        std::size_t fired = 0;
+
+        while (discard_stale() && queue_.top().expiry <= now)
+        {
+            auto state = queue_.top().state;
+            queue_.pop();
+
+            state->queued = false;
+
+            auto waiters = std::move(state->waiters);
+            state->waiters.clear();
+
+            for (auto op : waiters)
+                op->complete({});
+
+            ++fired;
+        }
+
+        fired_ += fired;
+        return fired;
+    }
+
+    // deadlines that have fired so far
+    std::uint64_t fired() const noexcept
+    {
+        return fired_;
+    }
+
+private:
+    template <typename _Handler, typename _Executor>
+    struct wait_op_impl
+        : public detail::wait_op
+    {
+        _Handler handler;
+        boost::asio::executor_work_guard<_Executor> work;
+        boost::asio::associated_cancellation_slot_t<_Handler> slot;
+
+        template <typename _H>
+        wait_op_impl(_H&& h, const _Executor& ex)
+            : handler(std::forward<_H>(h))
+            , work(ex)
+            , slot(boost::asio::get_associated_cancellation_slot(handler))
+        {
+            invoke = &do_invoke;
+        }
+
+        static void do_invoke(detail::wait_op* base, boost::system::error_code ec, bool destroy)
+        {
+            std::unique_ptr<wait_op_impl> self{ static_cast<wait_op_impl*>(base) };
+
+            if (self->slot.is_connected())
+                self->slot.clear();
+
+            if (destroy)
+                return;
+
+            // completions never run inside advance() or cancel(): they are posted like a real timer's
+            auto ex = boost::asio::get_associated_executor(self->handler, self->work.get_executor());
+            boost::asio::post(ex, [handler = std::move(self->handler), ec]() mutable
+            {
+                std::move(handler)(ec);
+            });
+
+            // the pending wait counted as work of the context until its completion was posted
+            self.reset();
+        }
+    };
+
+    struct entry
+    {
+        virtual_clock::time_point expiry;
+        std::uint64_t sequence;     // timers due at the same time fire in the order they were armed
+        std::uint64_t generation;
+        std::shared_ptr<detail::timer_state> state;
+
+        bool operator>(const entry& other) const noexcept
+        {
+            return expiry != other.expiry ? expiry > other.expiry : sequence > other.sequence;
+        }
+    };
+
+    // pops entries of cancelled, re-armed or abandoned timers; returns false when the queue is empty
+    bool discard_stale()
+    {
+        while (!queue_.empty())
+        {
+            auto& top = queue_.top();
+            if (top.generation == top.state->generation && !top.state->waiters.empty())
+                return true;
+
+            if (top.generation == top.state->generation)
+                top.state->queued = false;
+
+            queue_.pop();
+        }
+
+        return false;
+    }
+
+    void cancel_one(detail::timer_state& state, detail::wait_op* op)
+    {
+        auto it = std::find(state.waiters.begin(), state.waiters.end(), op);
+        if (it == state.waiters.end())
+            return;
+
+        state.waiters.erase(it);
+        op->complete(boost::asio::error::operation_aborted);
+    }
+
+    void shutdown() override
+    {
+        while (!queue_.empty())
+        {
+            auto state = queue_.top().state;
+            queue_.pop();
+
+            for (auto op : state->waiters)
+                op->destroy();
+
+            state->waiters.clear();
+        }
+    }
+
+    std::priority_queue<entry, std::vector<entry>, std::greater<>> queue_;
+    std::uint64_t sequence_ = 0;
+    std::uint64_t fired_ = 0;
+};
+
+
+// The subset of basic_waitable_timer the code in this repo uses, on the virtual clock.
+template <typename _Executor = boost::asio::any_io_executor>
+class basic_timer
+{
+public:
+    using executor_type = _Executor;
+    using clock_type = virtual_clock;
+    using duration = virtual_clock::duration;
+    using time_point = virtual_clock::time_point;
+
+    explicit basic_timer(const executor_type& ex)
+        : ex_(ex)
+        , service_(&boost::asio::use_service<virtual_time_service>(boost::asio::query(ex, boost::asio::execution::context)))
+        , state_(std::make_shared<detail::timer_state>())
+    {
+    }
+
+    basic_timer(const executor_type& ex, time_point expiry)
+        : basic_timer(ex)
+    {
+        state_->expiry = expiry;
+    }
+
+    basic_timer(const executor_type& ex, duration d)
+        : basic_timer(ex)
+    {
+        expires_after(d);
+    }
+
+    template <typename _ExecutionContext>
+        requires std::is_convertible_v<_ExecutionContext&, boost::asio::execution_context&>
+    explicit basic_timer(_ExecutionContext& context)
+        : basic_timer(context.get_executor())
+    {
+    }
+
+    template <typename _ExecutionContext, typename _Time>
+        requires std::is_convertible_v<_ExecutionContext&, boost::asio::execution_context&>
+    basic_timer(_ExecutionContext& context, _Time t)
+        : basic_timer(context.get_executor(), t)
+    {
+    }
+
+    ~basic_timer()
+    {
+        if (state_)
+            cancel();
+    }
+
+    basic_timer(const basic_timer&) = delete;
+    basic_timer& operator=(const basic_timer&) = delete;
+
+    basic_timer(basic_timer&&) = default;
+
+    executor_type get_executor() const noexcept
+    {
+        return ex_;
+    }
+
+    time_point expiry() const noexcept
+    {
+        return state_->expiry;
+    }
+
+    // like asio's, re-arming cancels the waits on the previous expiry
+    std::size_t expires_at(time_point expiry)
+    {
+        auto cancelled = cancel();
+        state_->expiry = expiry;
+
+        return cancelled;
+    }
+
+    std::size_t expires_after(duration d)
+    {
+        auto now = virtual_clock::now();
+
+        // saturate, so that expires_after(duration::max()) means never
+        return expires_at(d > time_point::max() - now ? time_point::max() : now + d);
+    }
+
+    std::size_t cancel()
+    {
+        return service_->cancel(*state_);
+    }
+
+    template <typename _WaitToken>
+    auto async_wait(_WaitToken&& token)
+    {
+        return boost::asio::async_initiate<_WaitToken, void(boost::system::error_code)>(
+            [this](auto handler)
+            {
+                service_->async_wait(state_, ex_, std::move(handler));
+            },
+            token
+        );
+    }
+
+private:
+    executor_type ex_;
+    virtual_time_service* service_;
+    std::shared_ptr<detail::timer_state> state_;
+};
+
+using virtual_timer = basic_timer<>;
+
+
+// Runs the context on the calling thread like io_context::run(), except that whenever no handler is
+// ready to run, i.e. every coroutine is suspended, the clock jumps to the next deadline. Pending
+// virtual waits count as work, so plain run() would block on them forever. Real I/O still works:
+// when no virtual timer is left, or only ones that never expire, this blocks for it just like run().
+//
+// Handlers run one at a time and timers already due are completed before each of them, so a
+// coroutine that keeps yielding does not hold back a timer armed for now(): poll() would not return
+// while such a coroutine is runnable. The clock itself still only moves when nothing is ready.
+//
+// virtual_clock is process-wide. Contexts run one after another (as in the benchmarks) each start
+// where the previous one left the clock; contexts run at the same time share it, and a jump made
+// by one completes the other's timers it passes on that other's next iteration.
+inline std::size_t run(boost::asio::io_context& io)
+{
+    VerboseBlock("virtual_time::run()");
+
+    auto& service = boost::asio::use_service<virtual_time_service>(io);
+    std::size_t handlers = 0;
+
+    while (!io.stopped())
+    {
+        service.complete_due();
+
+        if (auto n = io.poll_one())
+        {
+            handlers += n;
+            continue;
+        }
+
+        if (io.stopped())
+            break; // out of work
+
+        if (!service.advance())
+            handlers += io.run_one();
+    }
+
+    return handlers;
+}
+
+} // namespace virtual_time {}
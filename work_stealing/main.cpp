@@ -0,0 +1,56 @@
+#include "work_stealing.hxx"
+
+#include <latch>
+
+
+namespace
+{
+
+
+boost::asio::awaitable<void> f(auto serial) 
+{
+    VerboseBlock("f()");
+
+    Info("IO Context Executor");
+    co_await boost::asio::dispatch(boost::asio::bind_executor(serial, boost::asio::deferred));
+    Info("Serial Executor");
+    co_await boost::asio::dispatch(boost::asio::deferred);
+    Info("Back on IO Context Executor");
+}
+
+boost::asio::awaitable<void> leaf(std::size_t index, std::latch& done)
+{
+    Info("leaf #{} running on the pool", index);
+    done.count_down();
+    co_return;
+}
+
+
+} // namespace {}
+
+
+
+int main()
+{
+    VerboseBlock("main()");
+
+    work_stealing::work_stealing_pool pool(4);
+
+    {
+        boost::asio::io_context io;
+
+        co_spawn(io, f(work_stealing::make_serial(pool.get_executor())), boost::asio::detached);
+
+        io.run();
+    }
+
+    std::latch done{ 8 };
+    for (std::size_t i = 0; i < 8; ++i)
+        co_spawn(pool.get_executor(), leaf(i, done), boost::asio::detached);
+
+    done.wait();
+
+    pool.join();
+        
+    return 0;
+}
@@ -0,0 +1,955 @@
+#pragma once
+
+#include "common.hxx"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+
+namespace work_stealing
+{
+
+namespace detail
+{
+
+constexpr std::size_t CacheLine = 64;
+
+// work_stealing_pool::basic_executor_type property bits
+constexpr unsigned int BlockingNever = 1;
+constexpr unsigned int RelationshipContinuation = 2;
+constexpr unsigned int OutstandingWorkTracked = 4;
+
+
+// type-erased, intrusively linked unit of work
+struct operation
+{
+    operation* next = nullptr;
+    void (*invoke)(operation* op, bool destroy) = nullptr;
+
+    void complete()
+    {
+        invoke(this, false);
+    }
+
+    void destroy()
+    {
+        invoke(this, true);
+    }
+};
+
+template <typename _F>
+struct operation_impl
+    : public operation
+{
+    _F f;
+
+    template <typename _U>
+    explicit operation_impl(_U&& u)
+        : f(std::forward<_U>(u))
+    {
+        invoke = &do_invoke;
+    }
+
+    static void do_invoke(operation* base, bool destroy)
+    {
+        // take the function out of the node first, so the node's memory is released before the upcall
+        std::unique_ptr<operation_impl> self{ static_cast<operation_impl*>(base) };
+        if (destroy)
+            return;
+
+        _F f{ std::move(self->f) };
+        self.reset();
+
+        f();
+    }
+};
+
+template <typename _F>
+operation* make_operation(_F&& f)
+{
+    return new operation_impl<std::decay_t<_F>>(std::forward<_F>(f));
+}
+
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models").
+// The owner pushes and pops at the bottom (LIFO), thieves steal from the top (FIFO).
+// Fixed capacity: when it is full the owner falls back to the shared injection queue.
+class chase_lev_deque
+{
+public:
+    static constexpr std::int64_t Capacity = 4096;
+
+    bool push(operation* op) noexcept
+    {
+        auto b = bottom_.load(std::memory_order_relaxed);
+        auto t = top_.load(std::memory_order_acquire);
+        if (b - t >= Capacity)
+            return false;
+
+        buffer_[b & Mask].store(op, std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    operation* pop() noexcept
+    {
+        auto b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top_.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // empty
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto op = buffer_[b & Mask].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // the last element: race against thieves
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                op = nullptr;
+
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return op;
+    }
+
+    operation* steal() noexcept
+    {
+        auto t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return nullptr;
+
+        auto op = buffer_[t & Mask].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr; // lost the race
+
+        return op;
+    }
+
+    bool empty() const noexcept
+    {
+        return bottom_.load(std::memory_order_acquire) <= top_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr std::int64_t Mask = Capacity - 1;
+
+    alignas(CacheLine) std::atomic<std::int64_t> top_ = 0;
+    alignas(CacheLine) std::atomic<std::int64_t> bottom_ = 0;
+    alignas(CacheLine) std::array<std::atomic<operation*>, Capacity> buffer_ = {};
+};
+
+
+// Vyukov's intrusive multi-producer single-consumer queue. push() never blocks;
+// pop() may transiently return nullptr while a concurrent push() is half way through.
+class mpsc_queue
+{
+public:
+    mpsc_queue() noexcept
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+    }
+
+    void push(operation* op) noexcept
+    {
+        op->next = nullptr;
+        auto prev = head_.exchange(op, std::memory_order_acq_rel);
+        std::atomic_ref(prev->next).store(op, std::memory_order_release);
+    }
+
+    operation* pop() noexcept
+    {
+        auto tail = tail_;
+        auto next = std::atomic_ref(tail->next).load(std::memory_order_acquire);
+
+        if (tail == &stub_)
+        {
+            if (!next)
+                return nullptr;
+
+            tail_ = next;
+            tail = next;
+            next = std::atomic_ref(next->next).load(std::memory_order_acquire);
+        }
+
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+
+        if (tail != head_.load(std::memory_order_acquire))
+            return nullptr; // a producer is in the middle of push()
+
+        push(&stub_);
+
+        next = std::atomic_ref(tail->next).load(std::memory_order_acquire);
+        if (next)
+        {
+            tail_ = next;
+            return tail;
+        }
+
+        return nullptr;
+    }
+
+private:
+    alignas(CacheLine) std::atomic<operation*> head_;
+    alignas(CacheLine) operation* tail_;
+    operation stub_;
+};
+
+} // namespace detail {}
+
+
+// A thread pool where every worker owns a Chase-Lev deque plus a LIFO slot.
+// Work posted from a worker goes to its LIFO slot (the previous occupant moves to the deque), so a just-resumed continuation
+// runs next on the same thread with hot caches; idle workers steal from the top of other workers' deques.
+// Work posted from outside the pool goes through a shared injection queue.
+// The executor satisfies asio's standard executor requirements, so co_spawn(), dispatch(), post() and bind_executor() work unchanged.
+class work_stealing_pool
+    : public boost::asio::execution_context
+{
+public:
+    template <unsigned int _Bits>
+    class basic_executor_type;
+
+    using executor_type = basic_executor_type<0>;
+
+    ~work_stealing_pool()
+    {
+        VerboseBlock("work_stealing_pool::~work_stealing_pool()");
+
+        stop();
+        join_threads();
+        shutdown();
+
+        drain();
+    }
+
+    explicit work_stealing_pool(std::size_t threads = std::thread::hardware_concurrency())
+    {
+        VerboseBlock("work_stealing_pool::work_stealing_pool({})", threads);
+
+        if (!threads)
+            threads = 1;
+
+        workers_.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i)
+        {
+            workers_.push_back(std::make_unique<worker>());
+            workers_.back()->index = i;
+        }
+
+        for (std::size_t i = 0; i < threads; ++i)
+            workers_[i]->thread = std::thread([this, i]() { run(i); });
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    executor_type get_executor() noexcept;
+
+    // waits until all outstanding work has completed
+    void join()
+    {
+        VerboseBlock("work_stealing_pool::join()");
+
+        {
+            std::lock_guard l(lock_);
+            joining_.store(true, std::memory_order_relaxed);
+        }
+
+        wake_all();
+        join_threads();
+    }
+
+    // abandons queued work; the workers exit as soon as they finish what they are running
+    void stop()
+    {
+        VerboseBlock("work_stealing_pool::stop()");
+
+        {
+            std::lock_guard l(lock_);
+            stopped_.store(true, std::memory_order_relaxed);
+        }
+
+        wake_all();
+    }
+
+    bool running_in_this_thread() const noexcept
+    {
+        return current_.pool == this;
+    }
+
+    std::size_t concurrency() const noexcept
+    {
+        return workers_.size();
+    }
+
+private:
+    static constexpr std::size_t SpinRounds = 64;
+    static constexpr std::size_t InjectionInterval = 61; // look at the shared queue every so often, for fairness
+    static constexpr std::size_t MaxLifoPolls = 3;       // LIFO slot runs in a row before the oldest local operation gets a turn
+
+    struct alignas(detail::CacheLine) worker
+    {
+        detail::chase_lev_deque deque;
+        detail::operation* lifo = nullptr; // owner-only, thieves never see it
+        std::size_t lifo_polls = 0;        // consecutive operations taken from the LIFO slot
+        std::size_t tick = 0;
+        std::size_t index = 0;
+        std::thread thread;
+    };
+
+    struct thread_info
+    {
+        work_stealing_pool* pool;
+        worker* self;
+    };
+
+    static inline thread_local thread_info current_ = { nullptr, nullptr };
+
+    void post(detail::operation* op)
+    {
+        outstanding_.fetch_add(1, std::memory_order_relaxed);
+
+        if (current_.pool == this)
+        {
+            auto w = current_.self;
+
+            // An operation that keeps re-posting itself (a yield) would otherwise live in the LIFO slot
+            // forever and starve everything queued behind it. Once the slot has had its turns, the post
+            // goes to the deque like a displaced one, and next() takes the oldest from there first.
+            auto queued = w->lifo_polls >= MaxLifoPolls ? op : std::exchange(w->lifo, op);
+            if (!queued)
+                return;
+
+            if (!w->deque.push(queued))
+            {
+                inject(queued);
+                return;
+            }
+
+            wake_one();
+            return;
+        }
+
+        inject(op);
+    }
+
+    void inject(detail::operation* op)
+    {
+        {
+            std::lock_guard l(lock_);
+
+            op->next = nullptr;
+            if (injected_tail_)
+                injected_tail_->next = op;
+            else
+                injected_head_ = op;
+
+            injected_tail_ = op;
+            injected_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        wake_one();
+    }
+
+    detail::operation* pop_injected()
+    {
+        if (!injected_.load(std::memory_order_relaxed))
+            return nullptr;
+
+        std::lock_guard l(lock_);
+
+        auto op = injected_head_;
+        if (op)
+        {
+            injected_head_ = op->next;
+            if (!injected_head_)
+                injected_tail_ = nullptr;
+
+            injected_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        return op;
+    }
+
+    void work_started() noexcept
+    {
+        outstanding_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void work_finished() noexcept
+    {
+        if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard l(lock_);
+            if (joining_.load(std::memory_order_relaxed))
+                cv_.notify_all();
+        }
+    }
+
+    void wake_one()
+    {
+        // pairs with the fence in park(): either we see the sleeper, or it sees our push
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard l(lock_);
+            cv_.notify_one();
+        }
+    }
+
+    void wake_all()
+    {
+        std::lock_guard l(lock_);
+        cv_.notify_all();
+    }
+
+    detail::operation* steal(worker& self)
+    {
+        auto n = workers_.size();
+        auto start = self.index + self.tick;
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            auto& victim = *workers_[(start + i) % n];
+            if (&victim == &self)
+                continue;
+
+            if (auto op = victim.deque.steal())
+                return op;
+        }
+
+        return nullptr;
+    }
+
+    detail::operation* next(worker& self)
+    {
+        ++self.tick;
+
+        if (self.tick % InjectionInterval == 0)
+        {
+            if (auto op = pop_injected())
+            {
+                self.lifo_polls = 0;
+                return op;
+            }
+        }
+
+        if (auto op = std::exchange(self.lifo, nullptr))
+        {
+            ++self.lifo_polls;
+            return op;
+        }
+
+        // after a run of LIFO turns the owner takes from the top of its own deque, like a thief:
+        // an operation that keeps re-posting itself goes behind what was queued before it
+        if (std::exchange(self.lifo_polls, 0) >= MaxLifoPolls)
+        {
+            if (auto op = self.deque.steal())
+                return op;
+        }
+
+        if (auto op = self.deque.pop())
+            return op;
+
+        if (auto op = pop_injected())
+            return op;
+
+        return steal(self);
+    }
+
+    bool has_visible_work() const noexcept
+    {
+        if (injected_.load(std::memory_order_relaxed))
+            return true;
+
+        for (auto& w : workers_)
+        {
+            if (!w->deque.empty())
+                return true;
+        }
+
+        return false;
+    }
+
+    bool done() const noexcept
+    {
+        return stopped_.load(std::memory_order_relaxed) ||
+            (joining_.load(std::memory_order_relaxed) && outstanding_.load(std::memory_order_acquire) == 0);
+    }
+
+    // returns false if the worker should exit
+    bool park()
+    {
+        for (std::size_t i = 0; i < SpinRounds; ++i)
+        {
+            if (done())
+                return false;
+
+            if (has_visible_work())
+                return true;
+
+            std::this_thread::yield();
+        }
+
+        std::unique_lock l(lock_);
+
+        sleepers_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        cv_.wait(l, [this]() { return done() || has_visible_work(); });
+
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+
+        return !done();
+    }
+
+    void run(std::size_t index)
+    {
+        VerboseBlock("work_stealing_pool::run({})", index);
+
+        auto& self = *workers_[index];
+        current_ = thread_info{ this, &self };
+
+        for (;;)
+        {
+            if (auto op = next(self))
+            {
+                try
+                {
+                    op->complete();
+                }
+                catch (std::exception& e)
+                {
+                    Error("Caught [{}]", e.what());
+                }
+                catch (...)
+                {
+                    Error("Caught an unknown exception");
+                }
+
+                work_finished();
+
+                if (stopped_.load(std::memory_order_relaxed))
+                    break;
+
+                continue;
+            }
+
+            if (!park())
+                break;
+        }
+
+        current_ = thread_info{ nullptr, nullptr };
+    }
+
+    void join_threads()
+    {
+        for (auto& w : workers_)
+        {
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+
+    // destroys whatever is still queued once the workers are gone
+    void drain()
+    {
+        for (auto& w : workers_)
+        {
+            if (auto op = std::exchange(w->lifo, nullptr))
+                op->destroy();
+
+            while (auto op = w->deque.pop())
+                op->destroy();
+        }
+
+        while (auto op = pop_injected())
+            op->destroy();
+    }
+
+    std::vector<std::unique_ptr<worker>> workers_;
+
+    mutable std::mutex lock_; // guards the injection queue and parking
+    std::condition_variable cv_;
+    detail::operation* injected_head_ = nullptr;
+    detail::operation* injected_tail_ = nullptr;
+    std::atomic<std::size_t> injected_ = 0; // lets workers peek without the lock
+    std::atomic<bool> stopped_ = false;
+    std::atomic<bool> joining_ = false;
+
+    alignas(detail::CacheLine) std::atomic<std::size_t> outstanding_ = 0;
+    alignas(detail::CacheLine) std::atomic<std::size_t> sleepers_ = 0;
+};
+
+
+template <unsigned int _Bits>
+class work_stealing_pool::basic_executor_type
+{
+public:
+    ~basic_executor_type()
+    {
+        if (is_tracked() && pool_)
+            pool_->work_finished();
+    }
+
+    basic_executor_type(const basic_executor_type& o) noexcept
+        : pool_(o.pool_)
+    {
+        if (is_tracked() && pool_)
+            pool_->work_started();
+    }
+
+    basic_executor_type(basic_executor_type&& o) noexcept
+        : pool_(std::exchange(o.pool_, nullptr))
+    {
+    }
+
+    basic_executor_type& operator=(const basic_executor_type& o) noexcept
+    {
+        basic_executor_type tmp(o);
+        std::swap(pool_, tmp.pool_);
+        return *this;
+    }
+
+    basic_executor_type& operator=(basic_executor_type&& o) noexcept
+    {
+        std::swap(pool_, o.pool_);
+        return *this;
+    }
+
+    friend bool operator==(const basic_executor_type& a, const basic_executor_type& b) noexcept
+    {
+        return a.pool_ == b.pool_;
+    }
+
+    friend bool operator!=(const basic_executor_type& a, const basic_executor_type& b) noexcept
+    {
+        return a.pool_ != b.pool_;
+    }
+
+    work_stealing_pool& query(boost::asio::execution::context_t) const noexcept
+    {
+        return *pool_;
+    }
+
+    static constexpr boost::asio::execution::blocking_t query(boost::asio::execution::blocking_t) noexcept
+    {
+        if constexpr ((_Bits & detail::BlockingNever) != 0)
+            return boost::asio::execution::blocking.never;
+        else
+            return boost::asio::execution::blocking.possibly;
+    }
+
+    static constexpr boost::asio::execution::relationship_t query(boost::asio::execution::relationship_t) noexcept
+    {
+        if constexpr ((_Bits & detail::RelationshipContinuation) != 0)
+            return boost::asio::execution::relationship.continuation;
+        else
+            return boost::asio::execution::relationship.fork;
+    }
+
+    static constexpr boost::asio::execution::outstanding_work_t query(boost::asio::execution::outstanding_work_t) noexcept
+    {
+        if constexpr ((_Bits & detail::OutstandingWorkTracked) != 0)
+            return boost::asio::execution::outstanding_work.tracked;
+        else
+            return boost::asio::execution::outstanding_work.untracked;
+    }
+
+    static constexpr boost::asio::execution::mapping_t query(boost::asio::execution::mapping_t) noexcept
+    {
+        return boost::asio::execution::mapping.thread;
+    }
+
+    std::size_t query(boost::asio::execution::occupancy_t) const noexcept
+    {
+        return pool_->concurrency();
+    }
+
+    template <typename _Other>
+    constexpr std::allocator<void> query(boost::asio::execution::allocator_t<_Other>) const noexcept
+    {
+        return {};
+    }
+
+    basic_executor_type<_Bits & ~detail::BlockingNever> require(boost::asio::execution::blocking_t::possibly_t) const noexcept
+    {
+        return basic_executor_type<_Bits & ~detail::BlockingNever>(pool_);
+    }
+
+    basic_executor_type<_Bits | detail::BlockingNever> require(boost::asio::execution::blocking_t::never_t) const noexcept
+    {
+        return basic_executor_type<_Bits | detail::BlockingNever>(pool_);
+    }
+
+    basic_executor_type<_Bits & ~detail::RelationshipContinuation> require(boost::asio::execution::relationship_t::fork_t) const noexcept
+    {
+        return basic_executor_type<_Bits & ~detail::RelationshipContinuation>(pool_);
+    }
+
+    basic_executor_type<_Bits | detail::RelationshipContinuation> require(boost::asio::execution::relationship_t::continuation_t) const noexcept
+    {
+        return basic_executor_type<_Bits | detail::RelationshipContinuation>(pool_);
+    }
+
+    basic_executor_type<_Bits & ~detail::OutstandingWorkTracked> require(boost::asio::execution::outstanding_work_t::untracked_t) const noexcept
+    {
+        return basic_executor_type<_Bits & ~detail::OutstandingWorkTracked>(pool_);
+    }
+
+    basic_executor_type<_Bits | detail::OutstandingWorkTracked> require(boost::asio::execution::outstanding_work_t::tracked_t) const noexcept
+    {
+        return basic_executor_type<_Bits | detail::OutstandingWorkTracked>(pool_);
+    }
+
+    template <typename _Other>
+    basic_executor_type require(boost::asio::execution::allocator_t<_Other>) const noexcept
+    {
+        return *this; // operations are always allocated with operator new
+    }
+
+    bool running_in_this_thread() const noexcept
+    {
+        return pool_->running_in_this_thread();
+    }
+
+    template <typename _F>
+    void execute(_F&& f) const
+    {
+        if constexpr ((_Bits & detail::BlockingNever) == 0)
+        {
+            if (pool_->running_in_this_thread())
+            {
+                // blocking.possibly: run inline, like asio::thread_pool does
+                std::decay_t<_F> tmp(std::forward<_F>(f));
+                tmp();
+                return;
+            }
+        }
+
+        pool_->post(detail::make_operation(std::forward<_F>(f)));
+    }
+
+private:
+    friend class work_stealing_pool;
+
+    template <unsigned int>
+    friend class basic_executor_type;
+
+    static constexpr bool is_tracked() noexcept
+    {
+        return (_Bits & detail::OutstandingWorkTracked) != 0;
+    }
+
+    explicit basic_executor_type(work_stealing_pool* pool) noexcept
+        : pool_(pool)
+    {
+        if (is_tracked() && pool_)
+            pool_->work_started();
+    }
+
+    work_stealing_pool* pool_;
+};
+
+
+inline work_stealing_pool::executor_type work_stealing_pool::get_executor() noexcept
+{
+    return executor_type(this);
+}
+
+
+// Serializes the work submitted through it, like asio::strand, without taking a lock:
+// submitters push into a lock-free MPSC queue and only the one that finds it idle schedules a drain on the inner executor.
+template <typename _Executor>
+class serial_executor
+{
+    struct impl
+    {
+        explicit impl(_Executor ex)
+            : inner(std::move(ex))
+        {
+        }
+
+        ~impl()
+        {
+            while (auto op = queue.pop())
+                op->destroy();
+        }
+
+        _Executor inner;
+        detail::mpsc_queue queue;
+        alignas(detail::CacheLine) std::atomic<std::size_t> pending = 0;
+    };
+
+    static inline thread_local impl* running_ = nullptr;
+
+public:
+    using inner_executor_type = _Executor;
+
+    explicit serial_executor(_Executor ex)
+        : impl_(std::make_shared<impl>(std::move(ex)))
+        , blocking_never_(false)
+    {
+    }
+
+    friend bool operator==(const serial_executor& a, const serial_executor& b) noexcept
+    {
+        return a.impl_ == b.impl_ && a.blocking_never_ == b.blocking_never_;
+    }
+
+    friend bool operator!=(const serial_executor& a, const serial_executor& b) noexcept
+    {
+        return !(a == b);
+    }
+
+    const _Executor& get_inner_executor() const noexcept
+    {
+        return impl_->inner;
+    }
+
+    decltype(auto) query(boost::asio::execution::context_t) const noexcept
+    {
+        return boost::asio::query(impl_->inner, boost::asio::execution::context);
+    }
+
+    boost::asio::execution::blocking_t query(boost::asio::execution::blocking_t) const noexcept
+    {
+        if (blocking_never_)
+            return boost::asio::execution::blocking.never;
+
+        return boost::asio::execution::blocking.possibly;
+    }
+
+    serial_executor require(boost::asio::execution::blocking_t::possibly_t) const noexcept
+    {
+        return serial_executor(impl_, false);
+    }
+
+    serial_executor require(boost::asio::execution::blocking_t::never_t) const noexcept
+    {
+        return serial_executor(impl_, true);
+    }
+
+    bool running_in_this_thread() const noexcept
+    {
+        return running_ == impl_.get();
+    }
+
+    template <typename _F>
+    void execute(_F&& f) const
+    {
+        if (!blocking_never_ && running_in_this_thread())
+        {
+            std::decay_t<_F> tmp(std::forward<_F>(f));
+            tmp();
+            return;
+        }
+
+        impl_->queue.push(detail::make_operation(std::forward<_F>(f)));
+
+        if (impl_->pending.fetch_add(1, std::memory_order_acq_rel) == 0)
+            schedule(impl_);
+    }
+
+private:
+    static constexpr std::size_t BatchSize = 64; // yield the inner thread after this many
+
+    serial_executor(std::shared_ptr<impl> i, bool blocking_never) noexcept
+        : impl_(std::move(i))
+        , blocking_never_(blocking_never)
+    {
+    }
+
+    static void schedule(std::shared_ptr<impl> i)
+    {
+        auto ex = boost::asio::require(i->inner, boost::asio::execution::blocking.never);
+        ex.execute([i = std::move(i)]() mutable { drain(std::move(i)); });
+    }
+
+    // whoever moved 'pending' off zero owns the queue until it brings it back to zero
+    static void drain(std::shared_ptr<impl> i)
+    {
+        auto prev = std::exchange(running_, i.get());
+
+        std::size_t done = 0;
+        for (;;)
+        {
+            auto op = i->queue.pop();
+            if (!op)
+            {
+                // a producer has bumped 'pending' but not linked its node yet
+                std::this_thread::yield();
+                continue;
+            }
+
+            try
+            {
+                op->complete();
+            }
+            catch (std::exception& e)
+            {
+                Error("Caught [{}]", e.what());
+            }
+            catch (...)
+            {
+                Error("Caught an unknown exception");
+            }
+
+            ++done;
+
+            if (done == BatchSize || i->pending.load(std::memory_order_acquire) == done)
+            {
+                auto left = i->pending.fetch_sub(done, std::memory_order_acq_rel) - done;
+                if (left == 0)
+                    break;
+
+                if (done == BatchSize)
+                {
+                    // still own the queue, but let others use the inner thread
+                    running_ = prev;
+                    schedule(std::move(i));
+                    return;
+                }
+
+                done = 0;
+            }
+        }
+
+        running_ = prev;
+    }
+
+    std::shared_ptr<impl> impl_;
+    bool blocking_never_;
+};
+
+
+template <typename _Executor>
+serial_executor<_Executor> make_serial(_Executor ex)
+{
+    return serial_executor<_Executor>(std::move(ex));
+}
+
+} // namespace work_stealing {}